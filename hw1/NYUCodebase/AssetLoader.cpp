@@ -0,0 +1,211 @@
+#include "AssetLoader.h"
+#include <SDL.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "stb_image.h"
+#include "Profiler.h"
+
+AssetLoader::AssetLoader(int threadCount) : cache(NULL), pack(NULL), requested(0), delivered(0), threadCount(threadCount), stopping(false) {
+    if (threadCount <= 0) {
+        this->threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    }
+}
+
+AssetLoader::~AssetLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        requests.clear();
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (Result &result : results) {
+        Release(result.asset);
+    }
+}
+
+void AssetLoader::QueueImage(const std::string &path, const Callback &done) {
+    Request request = {IMAGE_REQUEST, path, 0, 0, 0, done};
+    Queue(request);
+}
+
+void AssetLoader::QueueFile(const std::string &path, const Callback &done) {
+    Request request = {FILE_REQUEST, path, 0, 0, 0, done};
+    Queue(request);
+}
+
+void AssetLoader::QueueSound(const std::string &path, int frequency, unsigned short format, int channels, const Callback &done) {
+    Request request = {SOUND_REQUEST, path, frequency, format, channels, done};
+    Queue(request);
+}
+
+void AssetLoader::Queue(const Request &request) {
+    // workers start with the first request, so a global loader is free until used
+    while ((int)workers.size() < threadCount) {
+        workers.push_back(std::thread(&AssetLoader::Work, this));
+    }
+    requested++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(request);
+    }
+    wake.notify_one();
+}
+
+void AssetLoader::Work() {
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (stopping) {
+                return;
+            }
+            request = requests.front();
+            requests.pop_front();
+        }
+        Result result;
+        result.asset.path = request.path;
+        result.done = request.done;
+        Decode(request, result.asset);
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+    }
+}
+
+static bool ReadFile(const std::string &path, std::vector<unsigned char> &data) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? size : 0);
+    bool ok = size >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+bool AssetLoader::FindPacked(const std::string &path, AssetView &view) const {
+    if (pack == NULL || path.compare(0, packFolder.size(), packFolder) != 0) {
+        return false;
+    }
+    return pack->Find(path.substr(packFolder.size()), view);
+}
+
+void AssetLoader::Decode(const Request &request, LoadedAsset &asset) {
+    AssetView view;
+    bool packed = FindPacked(request.path, view);
+    if (request.kind == IMAGE_REQUEST) {
+        TextureCacheKey key;
+        bool keyed = false;
+        if (cache != NULL && packed) {
+            TextureCache::MakeKey(request.path, view.data, view.size, key);
+            keyed = true;
+        } else if (cache != NULL) {
+            keyed = TextureCache::MakeKey(request.path, key);
+        }
+        TextureBlob blob;
+        if (keyed && cache->Find(key, blob)) {
+            asset.pixels = blob.pixels;
+            asset.width = blob.width;
+            asset.height = blob.height;
+            asset.mapping = blob.mapping;
+            asset.mappingSize = blob.mappingSize;
+            asset.ok = true;
+            return;
+        }
+        PROFILE_SCOPE("Decode image");
+        int comp;
+        if (packed) {
+            asset.pixels = stbi_load_from_memory(view.data, (int)view.size, &asset.width, &asset.height, &comp, STBI_rgb_alpha);
+        } else {
+            asset.pixels = stbi_load(request.path.c_str(), &asset.width, &asset.height, &comp, STBI_rgb_alpha);
+        }
+        asset.ok = asset.pixels != NULL;
+        if (asset.ok && keyed) {
+            cache->Store(key, asset.pixels, asset.width, asset.height);
+        }
+    } else if (request.kind == FILE_REQUEST) {
+        PROFILE_SCOPE("Read file");
+        if (packed) {
+            asset.bytes = view.data;
+            asset.byteCount = view.size;
+            asset.ok = true;
+            return;
+        }
+        asset.ok = ReadFile(request.path, asset.data);
+    } else {
+        PROFILE_SCOPE("Decode sound");
+        SDL_AudioSpec spec;
+        Uint8 *buffer;
+        Uint32 length;
+        SDL_RWops *source = packed ? SDL_RWFromConstMem(view.data, (int)view.size) : SDL_RWFromFile(request.path.c_str(), "rb");
+        if (SDL_LoadWAV_RW(source, 1, &spec, &buffer, &length) == NULL) {
+            return;
+        }
+        SDL_AudioCVT cvt;
+        if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq,
+                              request.format, (Uint8)request.channels, request.frequency) < 0) {
+            SDL_FreeWAV(buffer);
+            return;
+        }
+        // converts in place, in a buffer big enough for the largest intermediate step
+        asset.data.resize((size_t)length * std::max(cvt.len_mult, 1));
+        memcpy(asset.data.data(), buffer, length);
+        SDL_FreeWAV(buffer);
+        cvt.buf = asset.data.data();
+        cvt.len = (int)length;
+        if (cvt.needed && SDL_ConvertAudio(&cvt) < 0) {
+            asset.data.clear();
+            return;
+        }
+        asset.data.resize(cvt.needed ? cvt.len_cvt : length);
+        asset.ok = true;
+    }
+    asset.bytes = asset.data.data();
+    asset.byteCount = asset.data.size();
+}
+
+int AssetLoader::Update(size_t byteBudget) {
+    int handed = 0;
+    size_t bytes = 0;
+    while (bytes < byteBudget || handed == 0) {
+        Result result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (results.empty()) {
+                break;
+            }
+            result = std::move(results.front());
+            results.pop_front();
+        }
+        if (!result.asset.ok) {
+            std::cout << "Unable to load " << result.asset.path << ". Make sure the path is correct\n";
+        }
+        bytes += result.asset.Size();
+        result.done(result.asset);
+        Release(result.asset);
+        handed++;
+        delivered++;
+    }
+    return handed;
+}
+
+void AssetLoader::Release(LoadedAsset &asset) {
+    if (asset.mapping != NULL) {
+        TextureBlob blob;
+        blob.mapping = asset.mapping;
+        blob.mappingSize = asset.mappingSize;
+        TextureCache::Release(blob);
+    } else {
+        stbi_image_free((void *)asset.pixels);
+    }
+    asset.pixels = NULL;
+    asset.mapping = NULL;
+}
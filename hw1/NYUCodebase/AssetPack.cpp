@@ -0,0 +1,160 @@
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static size_t Align(size_t offset) {
+    return (offset + ASSET_PACK_ALIGNMENT - 1) & ~(size_t)(ASSET_PACK_ALIGNMENT - 1);
+}
+
+AssetPack::AssetPack() : mapping(NULL), mappingSize(0), entries(NULL), entryCount(0) {}
+
+AssetPack::~AssetPack() {
+    Close();
+}
+
+bool AssetPack::Open(const std::string &fileName) {
+    Close();
+    mapping = MapFile(fileName, mappingSize);
+    if (mapping == NULL) {
+        return false;
+    }
+    const unsigned char *bytes = (const unsigned char *)mapping;
+    const AssetPackHeader *header = (const AssetPackHeader *)bytes;
+    bool valid = mappingSize >= sizeof(AssetPackHeader) && header->magic == ASSET_PACK_MAGIC &&
+                 header->version == ASSET_PACK_VERSION &&
+                 sizeof(AssetPackHeader) + (uint64_t)header->entryCount * sizeof(AssetPackEntry) <= header->namesOffset &&
+                 header->namesOffset <= mappingSize;
+    // checking every entry once here means Find can trust them
+    const AssetPackEntry *directory = (const AssetPackEntry *)(bytes + sizeof(AssetPackHeader));
+    for (uint32_t i = 0; valid && i < header->entryCount; i++) {
+        const AssetPackEntry &entry = directory[i];
+        valid = entry.nameOffset >= header->namesOffset &&
+                (uint64_t)entry.nameOffset + entry.nameLength <= mappingSize &&
+                entry.offset <= mappingSize && entry.size <= mappingSize - entry.offset &&
+                (i == 0 || directory[i - 1].hash <= entry.hash);
+    }
+    if (!valid) {
+        std::cout << "Invalid asset pack " << fileName << "\n";
+        Close();
+        return false;
+    }
+    entries = directory;
+    entryCount = header->entryCount;
+    return true;
+}
+
+void AssetPack::Close() {
+    if (mapping != NULL) {
+        UnmapFile(mapping, mappingSize);
+    }
+    mapping = NULL;
+    mappingSize = 0;
+    entries = NULL;
+    entryCount = 0;
+}
+
+bool AssetPack::Find(const std::string &name, AssetView &view) const {
+    if (mapping == NULL) {
+        return false;
+    }
+    uint64_t hash = Fnv1a(name.data(), name.size());
+    const AssetPackEntry *end = entries + entryCount;
+    const AssetPackEntry *entry = std::lower_bound(entries, end, hash, [](const AssetPackEntry &entry, uint64_t hash) {
+        return entry.hash < hash;
+    });
+    const unsigned char *bytes = (const unsigned char *)mapping;
+    for (; entry != end && entry->hash == hash; entry++) {
+        if (entry->nameLength == name.size() && memcmp(bytes + entry->nameOffset, name.data(), name.size()) == 0) {
+            view.data = bytes + entry->offset;
+            view.size = (size_t)entry->size;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct PackedFile {
+    std::string name;
+    uint64_t hash;
+    std::vector<unsigned char> contents;
+};
+
+bool AssetPack::Write(const std::string &fileName, const std::string &folder, const std::vector<std::string> &names) {
+    std::vector<PackedFile> files(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        PackedFile &file = files[i];
+        file.name = names[i];
+        std::replace(file.name.begin(), file.name.end(), '\\', '/');
+        file.hash = Fnv1a(file.name.data(), file.name.size());
+        FILE *in = fopen((folder + names[i]).c_str(), "rb");
+        if (in == NULL) {
+            std::cout << "Unable to open " << folder + names[i] << "\n";
+            return false;
+        }
+        unsigned char buffer[16384];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+            file.contents.insert(file.contents.end(), buffer, buffer + count);
+        }
+        fclose(in);
+    }
+    std::sort(files.begin(), files.end(), [](const PackedFile &a, const PackedFile &b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+    });
+    for (size_t i = 1; i < files.size(); i++) {
+        if (files[i].name == files[i - 1].name) {
+            std::cout << files[i].name << " is listed twice\n";
+            return false;
+        }
+    }
+
+    AssetPackHeader header;
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = (uint32_t)files.size();
+    header.namesOffset = (uint32_t)(sizeof(AssetPackHeader) + files.size() * sizeof(AssetPackEntry));
+    std::vector<AssetPackEntry> directory(files.size());
+    size_t offset = header.namesOffset;
+    for (size_t i = 0; i < files.size(); i++) {
+        directory[i].hash = files[i].hash;
+        directory[i].nameOffset = (uint32_t)offset;
+        directory[i].nameLength = (uint32_t)files[i].name.size();
+        offset += files[i].name.size();
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        offset = Align(offset);
+        directory[i].offset = offset;
+        directory[i].size = files[i].contents.size();
+        offset += files[i].contents.size();
+    }
+
+    FILE *out = fopen(fileName.c_str(), "wb");
+    if (out == NULL) {
+        std::cout << "Unable to write " << fileName << "\n";
+        return false;
+    }
+    static const unsigned char padding[ASSET_PACK_ALIGNMENT] = {0};
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              fwrite(directory.data(), sizeof(AssetPackEntry), directory.size(), out) == directory.size();
+    offset = header.namesOffset;
+    for (size_t i = 0; ok && i < files.size(); i++) {
+        ok = fwrite(files[i].name.data(), 1, files[i].name.size(), out) == files[i].name.size();
+        offset += files[i].name.size();
+    }
+    for (size_t i = 0; ok && i < files.size(); i++) {
+        size_t paddingLength = directory[i].offset - offset;
+        ok = fwrite(padding, 1, paddingLength, out) == paddingLength &&
+             fwrite(files[i].contents.data(), 1, files[i].contents.size(), out) == files[i].contents.size();
+        offset = directory[i].offset + directory[i].size;
+    }
+    ok = fclose(out) == 0 && ok;
+    if (!ok) {
+        std::cout << "Unable to write " << fileName << "\n";
+        remove(fileName.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// "PAK1"
+#define ASSET_PACK_MAGIC 0x314b4150
+#define ASSET_PACK_VERSION 1
+// payloads start on this boundary, so the 16-bit tiles of a compiled map or
+// SIMD loads over pixels can read straight out of the mapping
+#define ASSET_PACK_ALIGNMENT 16
+
+struct AssetPackHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t namesOffset;
+};
+
+// the directory is sorted by hash, then name
+struct AssetPackEntry {
+	// FNV-1a of the name
+	uint64_t hash;
+	uint64_t offset;
+	uint64_t size;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+};
+
+// bytes inside an open pack, valid until it's closed
+struct AssetView {
+	AssetView() : data(0), size(0) {}
+
+	const unsigned char *data;
+	size_t size;
+
+	const char *Chars() const { return (const char*)data; }
+};
+
+// Every asset a game needs in one file: a header, a directory of entries
+// sorted by the hash of their name, the names, then each payload on an
+// ASSET_PACK_ALIGNMENT boundary. Open maps the whole pack, so startup costs
+// one open and one mmap however many assets there are, and Find is a binary
+// search over the directory that hands back a view into the mapping without
+// copying anything. Names are paths relative to the folder the pack was built
+// from, with forward slashes.
+class AssetPack {
+	public:
+		AssetPack();
+		~AssetPack();
+		AssetPack(const AssetPack&) = delete;
+		AssetPack &operator=(const AssetPack&) = delete;
+
+		// false if the file is missing or isn't a valid pack
+		bool Open(const std::string &fileName);
+		void Close();
+		bool IsOpen() const { return mapping != NULL; }
+
+		bool Find(const std::string &name, AssetView &view) const;
+
+		// packs folder + each of names into fileName
+		static bool Write(const std::string &fileName, const std::string &folder, const std::vector<std::string> &names);
+
+	private:
+		void *mapping;
+		size_t mappingSize;
+		const AssetPackEntry *entries;
+		uint32_t entryCount;
+};
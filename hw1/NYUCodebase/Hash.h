@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FNV1A_SEED 14695981039346656037ULL
+
+// 64-bit FNV-1a; pass the previous result as hash to continue over more bytes
+inline uint64_t Fnv1a(const void *data, size_t length, uint64_t hash = FNV1A_SEED) {
+	const unsigned char *bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// Maps a whole file read-only into memory; NULL if it's missing, empty or
+// can't be mapped. The view stays valid until UnmapFile, even after the file
+// is renamed over or deleted.
+void *MapFile(const std::string &path, size_t &size);
+void UnmapFile(void *view, size_t size);
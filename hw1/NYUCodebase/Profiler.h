@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Scoped timing zones. PROFILE_SCOPE("name") times the rest of the enclosing
+// block; the name must be a string literal (only the pointer is stored).
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#define PROFILE_BUFFER_SIZE 65536
+#define PROFILE_FRAME_WINDOW 512
+
+struct ProfileSample {
+	const char *name;
+	unsigned long long start;
+	unsigned long long end;
+	int depth;
+};
+
+// Fixed-size ring of the most recent samples recorded on one thread. Only the
+// owning thread writes; head is published with release ordering so an exporter
+// on another thread can read everything before it without taking a lock, then
+// re-reads head and drops whatever the owner overwrote in the meantime.
+struct ProfileBuffer {
+	ProfileBuffer(int threadIndex);
+
+	ProfileSample samples[PROFILE_BUFFER_SIZE];
+	std::atomic<unsigned long long> head;
+	int threadIndex;
+	int depth;
+};
+
+class Profiler {
+	public:
+		// nanoseconds since the profiler's epoch (first use)
+		static unsigned long long Now();
+
+		static void Record(const char *name, unsigned long long start, unsigned long long end, int depth);
+		static ProfileBuffer *ThreadBuffer();
+
+		// frame boundaries, called by GameLoop; frame times go into a rolling window
+		static void BeginFrame();
+		static void EndFrame();
+		// frame time percentile over the rolling window, in milliseconds
+		static double FramePercentile(double percentile);
+		static void PrintFrameStats();
+
+		// write every buffered sample as Chrome trace JSON (chrome://tracing,
+		// Perfetto) or as CSV, returns false if the file couldn't be opened
+		static bool WriteChromeTrace(const std::string &path);
+		static bool WriteCSV(const std::string &path);
+		// writes <prefix>.json and <prefix>.csv
+		static void WriteCapture(const std::string &prefix);
+
+		// "--profile <prefix>" on the command line, or empty
+		static std::string CapturePrefix(int argc, char *argv[]);
+
+		static bool enabled;
+
+	private:
+		static void CollectSamples(std::vector<ProfileSample> &samples, std::vector<int> &threads);
+
+		static unsigned long long frameStart;
+		static bool frameRecorded;
+		static float frameTimes[PROFILE_FRAME_WINDOW];
+		static int frameCount;
+};
+
+class ProfileScope {
+	public:
+		ProfileScope(const char *name);
+		~ProfileScope();
+
+	private:
+		const char *name;
+		unsigned long long start;
+};
@@ -1,13 +1,27 @@
 
 #include "ShaderProgram.h"
 
+#define MODEL_MATRIX_CACHED 1
+#define VIEW_MATRIX_CACHED 2
+#define PROJECTION_MATRIX_CACHED 4
+#define COLOR_CACHED 8
+
 void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
     
     // create the vertex shader
     vertexShader = LoadShaderFromFile(vertexShaderFile, GL_VERTEX_SHADER);
     // create the fragment shader
     fragmentShader = LoadShaderFromFile(fragmentShaderFile, GL_FRAGMENT_SHADER);
-    
+    Link();
+}
+
+void ShaderProgram::LoadFromSource(const char *vertexSource, size_t vertexLength, const char *fragmentSource, size_t fragmentLength) {
+    vertexShader = LoadShaderFromString(vertexSource, vertexLength, GL_VERTEX_SHADER);
+    fragmentShader = LoadShaderFromString(fragmentSource, fragmentLength, GL_FRAGMENT_SHADER);
+    Link();
+}
+
+void ShaderProgram::Link() {
     // Create the final shader program from our vertex and fragment shaders
     programID = glCreateProgram();
     glAttachShader(programID, vertexShader);
@@ -28,11 +42,16 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
     positionAttribute = glGetAttribLocation(programID, "position");
     texCoordAttribute = glGetAttribLocation(programID, "texCoord");
 	
+	cachedUniforms = 0;
 	SetColor(1.0f, 1.0f, 1.0f, 1.0f);
     
 }
 
 void ShaderProgram::Cleanup() {
+    if (programID != 0) {
+        // make sure a later program that reuses this name gets bound again
+        GLState::UseProgram(0);
+    }
     glDeleteProgram(programID);
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
@@ -40,29 +59,37 @@ void ShaderProgram::Cleanup() {
 
 GLuint ShaderProgram::LoadShaderFromFile(const std::string &shaderFile, GLenum type) {
     //Open a file stream with the file name
-    std::ifstream infile(shaderFile);
+    std::ifstream infile(shaderFile, std::ios::binary);
     
     if(infile.fail()) {
         std::cout << "Error opening shader file:" << shaderFile << std::endl;
     }
     
-    //Create a string buffer and stream the file to it
-    std::stringstream buffer;
-    buffer << infile.rdbuf();
+    // Read the whole file straight into one string
+    std::string contents;
+    infile.seekg(0, std::ios::end);
+    std::streamoff length = infile.tellg();
+    if(length > 0) {
+        contents.resize((size_t)length);
+        infile.seekg(0);
+        infile.read(&contents[0], contents.size());
+    }
     
     // Load the shader from the contents of the file
-    return LoadShaderFromString(buffer.str(), type);
+    return LoadShaderFromString(contents, type);
 }
 
 GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GLenum type) {
-    
+    return LoadShaderFromString(shaderContents.data(), shaderContents.size(), type);
+}
+
+GLuint ShaderProgram::LoadShaderFromString(const char *shaderString, size_t length, GLenum type) {
     
     // Create a shader of specified type
     GLuint shaderID = glCreateShader(type);
     
-    // Get the pointer to the C string from the STL string
-    const char *shaderString = shaderContents.c_str();
-    GLint shaderStringLength = (GLint) shaderContents.size();
+    // The source doesn't need a terminator when its length is given
+    GLint shaderStringLength = (GLint) length;
     
     // Set the shader source to the string and compile shader
     glShaderSource(shaderID, 1, &shaderString, &shaderStringLength);
@@ -83,22 +110,153 @@ GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GL
     return shaderID;
 }
 
+void ShaderProgram::Use() {
+    GLState::UseProgram(programID);
+}
+
 void ShaderProgram::SetColor(float r, float g, float b, float a) {
-	glUseProgram(programID);
-	glUniform4f(colorUniform, r, g, b, a);
+    glm::vec4 color(r, g, b, a);
+    Use();
+    if ((cachedUniforms & COLOR_CACHED) && cachedColor == color) {
+        GLState::CountElided();
+        return;
+    }
+    glUniform4f(colorUniform, r, g, b, a);
+    GLState::CountIssued();
+    cachedColor = color;
+    cachedUniforms |= COLOR_CACHED;
 }
 
 void ShaderProgram::SetViewMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
+    Use();
+    if ((cachedUniforms & VIEW_MATRIX_CACHED) && cachedViewMatrix == matrix) {
+        GLState::CountElided();
+        return;
+    }
     glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
+    GLState::CountIssued();
+    cachedViewMatrix = matrix;
+    cachedUniforms |= VIEW_MATRIX_CACHED;
 }
 
 void ShaderProgram::SetModelMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
+    Use();
+    if ((cachedUniforms & MODEL_MATRIX_CACHED) && cachedModelMatrix == matrix) {
+        GLState::CountElided();
+        return;
+    }
     glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
+    GLState::CountIssued();
+    cachedModelMatrix = matrix;
+    cachedUniforms |= MODEL_MATRIX_CACHED;
 }
 
 void ShaderProgram::SetProjectionMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
-    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);    
+    Use();
+    if ((cachedUniforms & PROJECTION_MATRIX_CACHED) && cachedProjectionMatrix == matrix) {
+        GLState::CountElided();
+        return;
+    }
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
+    GLState::CountIssued();
+    cachedProjectionMatrix = matrix;
+    cachedUniforms |= PROJECTION_MATRIX_CACHED;
+}
+
+unsigned long GLState::issuedCalls = 0;
+unsigned long GLState::elidedCalls = 0;
+unsigned long GLState::drawCalls = 0;
+GLuint GLState::currentProgram = 0;
+GLuint GLState::currentTexture = 0;
+bool GLState::textureBound = false;
+unsigned int GLState::enabledAttributes = 0;
+unsigned int GLState::pendingDisables = 0;
+
+void GLState::UseProgram(GLuint program) {
+    if (program == currentProgram && program != 0) {
+        elidedCalls++;
+        return;
+    }
+    glUseProgram(program);
+    issuedCalls++;
+    currentProgram = program;
+}
+
+void GLState::BindTexture(GLuint texture) {
+    if (textureBound && texture == currentTexture) {
+        elidedCalls++;
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    issuedCalls++;
+    currentTexture = texture;
+    textureBound = true;
+}
+
+void GLState::EnableVertexAttribArray(GLuint index) {
+    if (index >= 32) {
+        // not a real location (e.g. -1 for an attribute the shader optimized out)
+        return;
+    }
+    unsigned int bit = 1u << index;
+    if (pendingDisables & bit) {
+        // cancels a disable that was never sent
+        pendingDisables &= ~bit;
+        elidedCalls += 2;
+        return;
+    }
+    if (enabledAttributes & bit) {
+        elidedCalls++;
+        return;
+    }
+    glEnableVertexAttribArray(index);
+    issuedCalls++;
+    enabledAttributes |= bit;
+}
+
+void GLState::DisableVertexAttribArray(GLuint index) {
+    if (index >= 32) {
+        return;
+    }
+    unsigned int bit = 1u << index;
+    if (!(enabledAttributes & bit) || (pendingDisables & bit)) {
+        elidedCalls++;
+        return;
+    }
+    pendingDisables |= bit;
+}
+
+void GLState::ApplyPendingDisables() {
+    for (GLuint index = 0; pendingDisables != 0; ++index) {
+        unsigned int bit = 1u << index;
+        if (pendingDisables & bit) {
+            glDisableVertexAttribArray(index);
+            issuedCalls++;
+            enabledAttributes &= ~bit;
+            pendingDisables &= ~bit;
+        }
+    }
+}
+
+void GLState::DrawArrays(GLenum mode, GLint first, GLsizei count) {
+    ApplyPendingDisables();
+    glDrawArrays(mode, first, count);
+    drawCalls++;
+}
+
+void GLState::DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) {
+    ApplyPendingDisables();
+    glDrawArraysInstancedARB(mode, first, count, instanceCount);
+    drawCalls++;
+}
+
+void GLState::ResetStats() {
+    issuedCalls = 0;
+    elidedCalls = 0;
+    drawCalls = 0;
+}
+
+void GLState::PrintStats() {
+    std::cout << "GL state calls issued: " << issuedCalls << ", elided: " << elidedCalls
+              << ", draw calls: " << drawCalls << std::endl;
 }
@@ -0,0 +1,260 @@
+#include "TextureAtlas.h"
+#include "ShaderProgram.h"
+#include "stb_image.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// a run of the skyline: the packed area's top edge is at y from x to x + width
+struct SkylineSegment {
+    int x;
+    int y;
+    int width;
+};
+
+// y the rect would sit at if its left edge went at segment i, or -1 if it doesn't fit
+static int SkylineFit(const std::vector<SkylineSegment> &skyline, size_t i, int width, int height,
+                      int atlasWidth, int atlasHeight) {
+    if (skyline[i].x + width > atlasWidth) {
+        return -1;
+    }
+    int y = 0;
+    int remaining = width;
+    for (size_t j = i; remaining > 0; j++) {
+        y = std::max(y, skyline[j].y);
+        if (y + height > atlasHeight) {
+            return -1;
+        }
+        remaining -= skyline[j].width;
+    }
+    return y;
+}
+
+TextureAtlas::TextureAtlas() : texture(0), width(0), height(0) {}
+
+void TextureAtlas::AddImage(const std::string &name, const char *filePath) {
+    int width;
+    int height;
+    int comp;
+    unsigned char *pixels = stbi_load(filePath, &width, &height, &comp, STBI_rgb_alpha);
+    if (pixels == NULL) {
+        std::cout << "Unable to load image. Make sure the path is correct\n";
+        assert(false);
+        return;
+    }
+    AddPixels(name, pixels, width, height);
+    stbi_image_free(pixels);
+}
+
+void TextureAtlas::AddPixels(const std::string &name, const unsigned char *pixels, int width, int height) {
+    Image image;
+    image.name = name;
+    image.width = width;
+    image.height = height;
+    image.pixels.assign(pixels, pixels + (size_t)width * height * 4);
+    image.x = 0;
+    image.y = 0;
+    images.push_back(image);
+}
+
+bool TextureAtlas::PackSkyline(std::vector<Image*> &images, int atlasWidth, int atlasHeight, int padding) {
+    std::vector<SkylineSegment> skyline;
+    SkylineSegment floor = {0, 0, atlasWidth};
+    skyline.push_back(floor);
+    for (Image *image : images) {
+        int rectWidth = image->width + padding;
+        int rectHeight = image->height + padding;
+        // bottom-left rule: lowest top edge wins, then leftmost
+        int bestIndex = -1;
+        int bestY = 0;
+        for (size_t i = 0; i < skyline.size(); i++) {
+            int y = SkylineFit(skyline, i, rectWidth, rectHeight, atlasWidth, atlasHeight);
+            if (y >= 0 && (bestIndex < 0 || y < bestY)) {
+                bestIndex = (int)i;
+                bestY = y;
+            }
+        }
+        if (bestIndex < 0) {
+            return false;
+        }
+        image->x = skyline[bestIndex].x;
+        image->y = bestY;
+        // raise the skyline under the new rect and trim what it now covers
+        SkylineSegment raised = {image->x, bestY + rectHeight, rectWidth};
+        skyline.insert(skyline.begin() + bestIndex, raised);
+        for (size_t i = bestIndex + 1; i < skyline.size(); ) {
+            int overlap = raised.x + raised.width - skyline[i].x;
+            if (overlap <= 0) {
+                break;
+            }
+            skyline[i].x += overlap;
+            skyline[i].width -= overlap;
+            if (skyline[i].width > 0) {
+                break;
+            }
+            skyline.erase(skyline.begin() + i);
+        }
+        for (size_t i = 0; i + 1 < skyline.size(); ) {
+            if (skyline[i].y == skyline[i + 1].y) {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+    }
+    return true;
+}
+
+bool TextureAtlas::Pack(int padding, int maxSize) {
+    std::vector<Image*> order;
+    for (Image &image : images) {
+        order.push_back(&image);
+    }
+    // tall images first leave the flattest skyline
+    std::sort(order.begin(), order.end(), [](const Image *a, const Image *b) {
+        if (a->height != b->height) {
+            return a->height > b->height;
+        }
+        return a->width > b->width;
+    });
+    int atlasWidth = 64;
+    int atlasHeight = 64;
+    while (!PackSkyline(order, atlasWidth, atlasHeight, padding)) {
+        if (atlasWidth <= atlasHeight) {
+            atlasWidth *= 2;
+        } else {
+            atlasHeight *= 2;
+        }
+        if (atlasWidth > maxSize || atlasHeight > maxSize) {
+            std::cout << "Unable to fit " << images.size() << " images in a " << maxSize << "x" << maxSize << " atlas\n";
+            return false;
+        }
+    }
+
+    std::vector<unsigned char> pixels(atlasWidth * atlasHeight * 4, 0);
+    for (Image &image : images) {
+        for (int row = 0; row < image.height; row++) {
+            memcpy(&pixels[((image.y + row) * atlasWidth + image.x) * 4],
+                   &image.pixels[row * image.width * 4], image.width * 4);
+        }
+        AtlasRegion region;
+        region.u = (float)image.x / atlasWidth;
+        region.v = (float)image.y / atlasHeight;
+        region.width = (float)image.width / atlasWidth;
+        region.height = (float)image.height / atlasHeight;
+        region.pixelWidth = image.width;
+        region.pixelHeight = image.height;
+        regions[image.name] = region;
+    }
+    images.clear();
+
+    Cleanup();
+    texture = Upload(pixels.data(), atlasWidth, atlasHeight);
+    width = atlasWidth;
+    height = atlasHeight;
+    return true;
+}
+
+// value of key="..." inside tag, or "" if it isn't there
+static std::string Attribute(const std::string &tag, const char *key) {
+    std::string pattern = std::string(" ") + key + "=\"";
+    size_t start = tag.find(pattern);
+    if (start == std::string::npos) {
+        return "";
+    }
+    start += pattern.size();
+    return tag.substr(start, tag.find('"', start) - start);
+}
+
+bool TextureAtlas::LoadSheet(const char *texturePath, const char *xmlPath) {
+    std::ifstream file(xmlPath);
+    if (!file) {
+        std::cout << "Unable to open sheet " << xmlPath << "\n";
+        return false;
+    }
+    int comp;
+    int sheetWidth;
+    int sheetHeight;
+    unsigned char *pixels = stbi_load(texturePath, &sheetWidth, &sheetHeight, &comp, STBI_rgb_alpha);
+    if (pixels == NULL) {
+        std::cout << "Unable to load image. Make sure the path is correct\n";
+        assert(false);
+        return false;
+    }
+    Cleanup();
+    texture = Upload(pixels, sheetWidth, sheetHeight);
+    width = sheetWidth;
+    height = sheetHeight;
+    stbi_image_free(pixels);
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string xml = contents.str();
+    size_t position = 0;
+    while ((position = xml.find("<SubTexture", position)) != std::string::npos) {
+        size_t end = xml.find('>', position);
+        std::string tag = xml.substr(position, end - position);
+        position = end;
+        AtlasRegion region;
+        int x = atoi(Attribute(tag, "x").c_str());
+        int y = atoi(Attribute(tag, "y").c_str());
+        region.pixelWidth = atoi(Attribute(tag, "width").c_str());
+        region.pixelHeight = atoi(Attribute(tag, "height").c_str());
+        region.u = (float)x / width;
+        region.v = (float)y / height;
+        region.width = (float)region.pixelWidth / width;
+        region.height = (float)region.pixelHeight / height;
+        regions[Attribute(tag, "name")] = region;
+    }
+    return true;
+}
+
+bool TextureAtlas::Region(const std::string &name, AtlasRegion &region) const {
+    std::map<std::string, AtlasRegion>::const_iterator found = regions.find(name);
+    if (found == regions.end()) {
+        std::cout << "No sprite named " << name << " in the atlas\n";
+        region = AtlasRegion();
+        return false;
+    }
+    region = found->second;
+    return true;
+}
+
+bool TextureAtlas::TexCoords(const std::string &name, float texCoords[12]) const {
+    AtlasRegion region;
+    bool found = Region(name, region);
+    float left = region.u;
+    float right = region.u + region.width;
+    float top = region.v;
+    float bottom = region.v + region.height;
+    float coords[12] = {right, top, left, bottom, right, bottom, left, top, left, bottom, right, top};
+    memcpy(texCoords, coords, sizeof(coords));
+    return found;
+}
+
+GLuint TextureAtlas::Upload(const unsigned char *pixels, int width, int height) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLState::BindTexture(texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // sprites on the atlas border mustn't blend with the opposite edge
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+void TextureAtlas::Cleanup() {
+    if (texture != 0) {
+        // keep GLState's idea of the bound texture valid if the name gets reused
+        GLState::BindTexture(0);
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+}
@@ -7,10 +7,17 @@
 #include <SDL_image.h>
 
 #include "ShaderProgram.h"
+#include "GameLoop.h"
+#include "Profiler.h"
+#include "TextureAtlas.h"
+#include "AssetLoader.h"
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include <chrono>
+#include <vector>
+#include <string>
 
 #ifdef _WINDOWS
 #define RESOURCE_FOLDER ""
@@ -18,27 +25,23 @@
 #define RESOURCE_FOLDER "NYUCodebase.app/Contents/Resources/"
 #endif
 
-SDL_Window* displayWindow;
+#define FIXED_TIMESTEP 0.0166666f
+// decoded image bytes handed to GL per frame while loading
+#define ASSET_UPLOAD_BUDGET (1024 * 1024)
 
-GLuint LoadTexture(const char *filePath) {
-    int w,h,comp;
-    unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-    if(image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
-    }
-    GLuint retTexture;
-    glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    stbi_image_free(image);
-    return retTexture;
-}
+SDL_Window* displayWindow;
 
 int main(int argc, char *argv[])
 {
+    // --pack <out.pack> <folder/> <files...> builds an asset pack instead of
+    // running the game
+    if (argc >= 4 && std::string(argv[1]) == "--pack") {
+        return AssetPack::Write(argv[2], argv[3], std::vector<std::string>(argv + 4, argv + argc)) ? 0 : 1;
+    }
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    auto millisecondsSinceStart = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    };
     SDL_Init(SDL_INIT_VIDEO);
     displayWindow = SDL_CreateWindow("My Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 640, 360, SDL_WINDOW_OPENGL);
     SDL_GLContext context = SDL_GL_CreateContext(displayWindow);
@@ -56,40 +59,90 @@ int main(int argc, char *argv[])
     glm::mat4 modelMatrixGround = glm::translate(modelMatrix, glm::vec3(0.0f, -1.0f, 0.0f));
     modelMatrixGround = glm::scale(modelMatrixGround, glm::vec3(5.0f, 1.0f, 1.0f));
     
-    // Setting alien matrices
-    glm::mat4 modelMatrixAlien1 = glm::translate(modelMatrix, glm::vec3(-1.5f, -0.22f, 0.0f));
-    modelMatrixAlien1 = glm::scale(modelMatrixAlien1, glm::vec3(0.5f, 0.75f, 1.0f));
-    glm::mat4 modelMatrixAlien2 = glm::translate(modelMatrix, glm::vec3(-0.75f, -0.22f, 0.0f));
-    modelMatrixAlien2 = glm::scale(modelMatrixAlien2, glm::vec3(0.5f, 0.75f, 1.0f));
-    glm::mat4 modelMatrixAlien3 = glm::translate(modelMatrix, glm::vec3(0.0f, -0.22f, 0.0f));
-    modelMatrixAlien3 = glm::scale(modelMatrixAlien3, glm::vec3(0.5f, 0.75f, 1.0f));
-    glm::mat4 modelMatrixAlien4 = glm::translate(modelMatrix, glm::vec3(0.75f, -0.22f, 0.0f));
-    modelMatrixAlien4 = glm::scale(modelMatrixAlien4, glm::vec3(0.5f, 0.75f, 1.0f));
-    glm::mat4 modelMatrixAlien5 = glm::translate(modelMatrix, glm::vec3(1.5f, -0.22f, 0.0f));
-    modelMatrixAlien5 = glm::scale(modelMatrixAlien5, glm::vec3(0.5f, 0.75f, 1.0f));
-    
-    // Vertices & texture coordinates for texturing
+    // Vertices for the ground
     float vertices[] = {0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, 0.5};
-    float texCoords[] = {1.0, 0.0, 0.0, 1.0, 1.0, 1.0, 0.0, 0.0, 0.0, 1.0, 1.0, 0.0};
 
     // Normal shader
+    // Everything comes out of one mapped file when the pack has been built,
+    // otherwise from the loose files
+    AssetPack pack;
+    pack.Open(RESOURCE_FOLDER"assets.pack");
     ShaderProgram program;
-    program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
-    glUseProgram(program.programID);
+    ShaderProgram program_textured;
+    {
+        PROFILE_SCOPE("Load shaders");
+        AssetView vertex, fragment;
+        if (pack.Find("vertex.glsl", vertex) && pack.Find("fragment.glsl", fragment)) {
+            program.LoadFromSource(vertex.Chars(), vertex.size, fragment.Chars(), fragment.size);
+        } else {
+            program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
+        }
+        if (pack.Find("vertex_textured.glsl", vertex) && pack.Find("fragment_textured.glsl", fragment)) {
+            program_textured.LoadFromSource(vertex.Chars(), vertex.size, fragment.Chars(), fragment.size);
+        } else {
+            program_textured.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
+        }
+    }
+    program.Use();
 
     // Texture shader
-    ShaderProgram program_textured;
-    program_textured.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glUseProgram(program_textured.programID);
+    program_textured.Use();
+    
+    // Texture assets are decoded on worker threads and packed into one atlas
+    // once they've all arrived; the ground is drawn on its own until then
+    const char *alienNames[] = {"alienGreen", "alienPink", "alienYellow", "alienBlue", "alienBeige"};
+    TextureAtlas atlas;
+    // decoded images are kept under the per-user data folder between runs; the
+    // cache is declared first so it outlives the loader's workers
+    TextureCache textureCache("");
+    AssetLoader assets;
+    if (pack.IsOpen()) {
+        assets.pack = &pack;
+        assets.packFolder = RESOURCE_FOLDER;
+    }
+    char *cachePath = SDL_GetPrefPath("NYUCodebase", "hw1");
+    if (cachePath != NULL) {
+        textureCache.directory = cachePath;
+        assets.cache = &textureCache;
+        SDL_free(cachePath);
+    }
+    for (const char *name : alienNames) {
+        assets.QueueImage(std::string(RESOURCE_FOLDER"assets/") + name + ".png", [&atlas, name](LoadedAsset &asset) {
+            if (asset.ok) {
+                atlas.AddPixels(name, asset.pixels, asset.width, asset.height);
+            }
+        });
+    }
+    bool aliensReady = false;
     
-    // Texture assets
-    GLuint alienTexture1 = LoadTexture(RESOURCE_FOLDER"assets/alienGreen.png");
-    GLuint alienTexture2 = LoadTexture(RESOURCE_FOLDER"assets/alienPink.png");
-    GLuint alienTexture3 = LoadTexture(RESOURCE_FOLDER"assets/alienYellow.png");
-    GLuint alienTexture4 = LoadTexture(RESOURCE_FOLDER"assets/alienBlue.png");
-    GLuint alienTexture5 = LoadTexture(RESOURCE_FOLDER"assets/alienBeige.png");
+    // The aliens don't move, so their quads are placed in world space once
+    // and all five go out in a single draw call
+    std::vector<float> alienVertices;
+    std::vector<float> alienTexCoords;
+    auto buildAliens = [&]() {
+        {
+            PROFILE_SCOPE("Pack atlas");
+            atlas.Pack();
+        }
+        for (int i = 0; i < 5; i++) {
+            // an alien whose image didn't load is left out
+            float texCoords[12];
+            if (!atlas.TexCoords(alienNames[i], texCoords)) {
+                continue;
+            }
+            float x = -1.5f + i * 0.75f;
+            float y = -0.22f;
+            for (int j = 0; j < 6; j++) {
+                alienVertices.push_back(x + vertices[j * 2] * 0.5f);
+                alienVertices.push_back(y + vertices[j * 2 + 1] * 0.75f);
+            }
+            alienTexCoords.insert(alienTexCoords.end(), texCoords, texCoords + 12);
+        }
+        aliensReady = true;
+        std::cout << "Assets loaded after " << millisecondsSinceStart() << " ms" << std::endl;
+    };
     
 
 #ifdef _WINDOWS
@@ -98,13 +151,23 @@ int main(int argc, char *argv[])
 
     SDL_Event event;
     bool done = false;
-    while (!done) {
+    bool firstFrameReported = false;
+    GameLoop loop(FIXED_TIMESTEP);
+    loop.Run(done, [&]() {
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT || event.type == SDL_WINDOWEVENT_CLOSE) {
                 done = true;
             }
         }
-        
+    }, [](float elapsed) {
+        // the scene is static, nothing to simulate
+    }, [&](float alpha) {
+        if (!aliensReady) {
+            assets.Update(ASSET_UPLOAD_BUDGET);
+            if (assets.Finished()) {
+                buildAliens();
+            }
+        }
         // Clearing screen
         glClearColor(0.8f, 0.8f, 0.8f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -115,45 +178,42 @@ int main(int argc, char *argv[])
         program.SetViewMatrix(viewMatrix);
         // Drawing ground
         glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glEnableVertexAttribArray(program.positionAttribute);
+        GLState::EnableVertexAttribArray(program.positionAttribute);
         program.SetColor(0.5f, 0.3f, 0.3f, 1.0f);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        GLState::DrawArrays(GL_TRIANGLES, 0, 6);
         // glDisables
-        glDisableVertexAttribArray(program.positionAttribute);
+        GLState::DisableVertexAttribArray(program.positionAttribute);
         
-        // Setting up drawing aliens
-        program_textured.SetProjectionMatrix(projectionMatrix);
-        program_textured.SetViewMatrix(viewMatrix);
-        glVertexAttribPointer(program_textured.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glEnableVertexAttribArray(program_textured.positionAttribute);
-        glVertexAttribPointer(program_textured.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-        glEnableVertexAttribArray(program_textured.texCoordAttribute);
-        // Drawing alien1
-        program_textured.SetModelMatrix(modelMatrixAlien1);
-        glBindTexture(GL_TEXTURE_2D, alienTexture1);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // Drawing alien2
-        program_textured.SetModelMatrix(modelMatrixAlien2);
-        glBindTexture(GL_TEXTURE_2D, alienTexture2);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // Drawing alien3
-        program_textured.SetModelMatrix(modelMatrixAlien3);
-        glBindTexture(GL_TEXTURE_2D, alienTexture3);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // Drawing alien4
-        program_textured.SetModelMatrix(modelMatrixAlien4);
-        glBindTexture(GL_TEXTURE_2D, alienTexture4);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // Drawing alien5
-        program_textured.SetModelMatrix(modelMatrixAlien5);
-        glBindTexture(GL_TEXTURE_2D, alienTexture5);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        // glDisables
-        glDisableVertexAttribArray(program_textured.positionAttribute);
-        glDisableVertexAttribArray(program_textured.texCoordAttribute);
+        if (aliensReady) {
+            // Setting up drawing aliens
+            program_textured.SetProjectionMatrix(projectionMatrix);
+            program_textured.SetViewMatrix(viewMatrix);
+            program_textured.SetModelMatrix(modelMatrix);
+            glVertexAttribPointer(program_textured.positionAttribute, 2, GL_FLOAT, false, 0, alienVertices.data());
+            GLState::EnableVertexAttribArray(program_textured.positionAttribute);
+            glVertexAttribPointer(program_textured.texCoordAttribute, 2, GL_FLOAT, false, 0, alienTexCoords.data());
+            GLState::EnableVertexAttribArray(program_textured.texCoordAttribute);
+            // Drawing aliens
+            GLState::BindTexture(atlas.texture);
+            GLState::DrawArrays(GL_TRIANGLES, 0, (GLsizei)alienVertices.size() / 2);
+            // glDisables
+            GLState::DisableVertexAttribArray(program_textured.positionAttribute);
+            GLState::DisableVertexAttribArray(program_textured.texCoordAttribute);
+        }
         
         // Display
         SDL_GL_SwapWindow(displayWindow);
+        if (!firstFrameReported) {
+            std::cout << "First frame after " << millisecondsSinceStart() << " ms" << std::endl;
+            firstFrameReported = true;
+        }
+    });
+    loop.PrintStats();
+    atlas.Cleanup();
+    Profiler::PrintFrameStats();
+    std::string profilePrefix = Profiler::CapturePrefix(argc, argv);
+    if (!profilePrefix.empty()) {
+        Profiler::WriteCapture(profilePrefix);
     }
     
     SDL_Quit();
@@ -10,13 +10,18 @@
 #include <fstream>
 #include <sstream>
 #include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
 
 class ShaderProgram {
     public:
 	
 		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
+		// sources that are already in memory, like asset pack entries
+		void LoadFromSource(const char *vertexSource, size_t vertexLength, const char *fragmentSource, size_t fragmentLength);
 		void Cleanup();
 
+		void Use();
+
 		void SetModelMatrix(const glm::mat4 &matrix);
         void SetProjectionMatrix(const glm::mat4 &matrix);
         void SetViewMatrix(const glm::mat4 &matrix);
@@ -24,6 +29,7 @@ class ShaderProgram {
 		void SetColor(float r, float g, float b, float a);
 	
         GLuint LoadShaderFromString(const std::string &shaderContents, GLenum type);
+        GLuint LoadShaderFromString(const char *shaderString, size_t length, GLenum type);
         GLuint LoadShaderFromFile(const std::string &shaderFile, GLenum type);
     
         GLuint programID;
@@ -38,4 +44,52 @@ class ShaderProgram {
     
         GLuint vertexShader;
         GLuint fragmentShader;
+
+    private:
+        void Link();
+
+        // last values uploaded to this program, so unchanged uniforms aren't re-sent
+        glm::mat4 cachedModelMatrix;
+        glm::mat4 cachedViewMatrix;
+        glm::mat4 cachedProjectionMatrix;
+        glm::vec4 cachedColor;
+        unsigned int cachedUniforms;
+};
+
+// Shadows the GL state the games change most often (bound program, bound
+// texture, enabled vertex attribute arrays) and skips calls that wouldn't
+// change anything. All code should go through these instead of calling GL
+// directly, otherwise the shadow copy goes stale.
+//
+// Disabling an attribute array is deferred until the next DrawArrays, so the
+// usual enable/draw/disable pattern costs nothing when consecutive draws use
+// the same attributes.
+class GLState {
+    public:
+        static void UseProgram(GLuint program);
+        static void BindTexture(GLuint texture);
+        static void EnableVertexAttribArray(GLuint index);
+        static void DisableVertexAttribArray(GLuint index);
+        static void DrawArrays(GLenum mode, GLint first, GLsizei count);
+        // glDrawArraysInstancedARB is ARB_draw_instanced, and the per instance
+        // attributes it needs are ARB_instanced_arrays; callers check for both
+        static void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount);
+
+        static void CountIssued() { issuedCalls++; }
+        static void CountElided() { elidedCalls++; }
+        static void ResetStats();
+        static void PrintStats();
+
+        static unsigned long issuedCalls;
+        static unsigned long elidedCalls;
+        static unsigned long drawCalls;
+
+    private:
+        static void ApplyPendingDisables();
+
+        static GLuint currentProgram;
+        static GLuint currentTexture;
+        static bool textureBound;
+        static unsigned int enabledAttributes;
+        static unsigned int pendingDisables;
 };
@@ -5,8 +5,12 @@
 #define GL_GLEXT_PROTOTYPES 1
 #include <SDL_opengl.h>
 #include <SDL_image.h>
+#include <cmath>
+#include <cstdlib>
 
 #include "ShaderProgram.h"
+#include "GameLoop.h"
+#include "Profiler.h"
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #define STB_IMAGE_IMPLEMENTATION
@@ -18,13 +22,14 @@
 #define RESOURCE_FOLDER "NYUCodebase.app/Contents/Resources/"
 #endif
 
+#define FIXED_TIMESTEP 0.0166666f
+
 SDL_Window* displayWindow;
 glm::mat4 modelMatrix = glm::mat4(1.0);
 glm::mat4 viewMatrix = glm::mat4(1.0);
 glm::mat4 projectionMatrix = glm::mat4(1.0);
 ShaderProgram program;
 bool gameDone = false;
-float lastFrameTicks = 0.0;
 const Uint8 *keys = SDL_GetKeyboardState(NULL);
 
 // Although the base and derived classes below aren't really necessary for a game of pong, I thought I'd practice abstracting game objects for future assignments.
@@ -32,13 +37,22 @@ class Object {
 public:
     Object(float pixelX, float pixelY, float velocityX, float velocityY, float pixelWidth,
            float pixelHeight, float colorR, float colorG, float colorB)
-           : pixelX(pixelX), pixelY(pixelY), velocityX(velocityX), velocityY(velocityY), pixelWidth(pixelWidth),
-             pixelHeight(pixelHeight), colorR(colorR), colorG(colorG), colorB(colorB) {}
+           : pixelX(pixelX), pixelY(pixelY), previousPixelX(pixelX), previousPixelY(pixelY), velocityX(velocityX),
+             velocityY(velocityY), pixelWidth(pixelWidth), pixelHeight(pixelHeight), colorR(colorR), colorG(colorG), colorB(colorB) {}
+    
+    // remember where we were before this step, for interpolated drawing
+    void savePosition() {
+        previousPixelX = pixelX;
+        previousPixelY = pixelY;
+    }
     
-    void draw(ShaderProgram &p) {
+    void draw(ShaderProgram &p, float alpha) {
+        // Interpolating between the last two steps
+        float renderX = previousPixelX + (pixelX - previousPixelX) * alpha;
+        float renderY = previousPixelY + (pixelY - previousPixelY) * alpha;
         // Transforming matrix
-        float unitX = ((pixelX / 960) * 2.666) - 1.333;
-        float unitY = (((720 - pixelY) / 720) * 2.0) - 1.0;
+        float unitX = ((renderX / 960) * 2.666) - 1.333;
+        float unitY = (((720 - renderY) / 720) * 2.0) - 1.0;
         float width = (pixelWidth / 960) * 2.666;
         float height = (pixelHeight / 720) * 2.0;
         glm::mat4 objectModelMatrix = glm::translate(modelMatrix, glm::vec3(unitX, unitY, 0.0));
@@ -48,13 +62,15 @@ public:
         // Draw
         float vertices[] = {0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, 0.5};
         glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glEnableVertexAttribArray(p.positionAttribute);
+        GLState::EnableVertexAttribArray(p.positionAttribute);
         p.SetColor(colorR, colorG, colorB, 1.0f);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        GLState::DrawArrays(GL_TRIANGLES, 0, 6);
     }
     
     float pixelX;
     float pixelY;
+    float previousPixelX;
+    float previousPixelY;
     float velocityX;
     float velocityY;
     float pixelWidth;
@@ -76,6 +92,45 @@ public:
         return false;
     }
     
+    // Swept box test: moving by dx, dy relative to obj, finds the fraction of
+    // the move (0 to 1) at which the boxes first touch, and the side of obj
+    // that was hit. Boxes that already overlap at the start don't count, so
+    // something that has just bounced off can always leave.
+    bool sweep(const Object &obj, float dx, float dy, float &time, float &normalX, float &normalY) const {
+        float halfWidth = (pixelWidth + obj.pixelWidth) / 2;
+        float halfHeight = (pixelHeight + obj.pixelHeight) / 2;
+        float entryX = -INFINITY;
+        float exitX = INFINITY;
+        float entryY = -INFINITY;
+        float exitY = INFINITY;
+        if (dx != 0) {
+            entryX = (obj.pixelX - (dx > 0 ? halfWidth : -halfWidth) - pixelX) / dx;
+            exitX = (obj.pixelX + (dx > 0 ? halfWidth : -halfWidth) - pixelX) / dx;
+        } else if (fabs(pixelX - obj.pixelX) >= halfWidth) {
+            return false;
+        }
+        if (dy != 0) {
+            entryY = (obj.pixelY - (dy > 0 ? halfHeight : -halfHeight) - pixelY) / dy;
+            exitY = (obj.pixelY + (dy > 0 ? halfHeight : -halfHeight) - pixelY) / dy;
+        } else if (fabs(pixelY - obj.pixelY) >= halfHeight) {
+            return false;
+        }
+        float entry = fmaxf(entryX, entryY);
+        float exit = fminf(exitX, exitY);
+        if (entry >= exit || entry < 0 || entry > 1) {
+            return false;
+        }
+        time = entry;
+        if (entryX > entryY) {
+            normalX = dx > 0 ? -1 : 1;
+            normalY = 0;
+        } else {
+            normalX = 0;
+            normalY = dy > 0 ? -1 : 1;
+        }
+        return true;
+    }
+    
     virtual void reset() = 0;
 };
 
@@ -88,6 +143,7 @@ public:
         pixelY = 360;
         velocityX = 0;
         velocityY = 0;
+        savePosition();
     }
 };
 class Player : public MovingObject {
@@ -98,6 +154,7 @@ public:
         pixelY = 360;
         velocityX = 0;
         velocityY = 0;
+        savePosition();
     }
 };
 class Wall : public Object {
@@ -126,8 +183,11 @@ void Setup() {
     SDL_GL_MakeCurrent(displayWindow, context);
     glViewport(0, 0, 960, 720);
     projectionMatrix = glm::ortho(-1.333, 1.333, -1.0, 1.0, -1.0, 1.0);
-    program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
-    glUseProgram(program.programID);
+    {
+        PROFILE_SCOPE("Load shaders");
+        program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
+    }
+    program.Use();
     program.SetProjectionMatrix(projectionMatrix);
     program.SetViewMatrix(viewMatrix);
 }
@@ -160,11 +220,87 @@ void ProcessEvents() {
     }
 }
 
-void Update() {
-    // Update ticks
-    float ticks = SDL_GetTicks()/1000.0;
-    float elapsed = ticks - lastFrameTicks;
-    lastFrameTicks = ticks;
+// bounces the ball can make in one step; it stops at the last one and the
+// rest of the step is dropped
+#define BALL_MAX_BOUNCES 8
+
+// Moves the ball through the step one contact at a time: it goes exactly as
+// far as the earliest thing it would touch, bounces, and carries on for
+// whatever is left of the step. Nothing is skipped however fast the ball is
+// going or however long the step. The paddles start the step where they were
+// and end it moved by paddle1Move and paddle2Move, unless someone scores.
+void moveBall(float elapsed, float paddle1Move, float paddle2Move) {
+    enum { PADDLE1, PADDLE2, UPPER_WALL, LOWER_WALL, LEFT_GOAL, RIGHT_GOAL, OBSTACLE_COUNT };
+    Object *obstacles[OBSTACLE_COUNT] = {&player1, &player2, &upperWall, &lowerWall, &leftGoal, &rightGoal};
+    float obstacleMoves[OBSTACLE_COUNT] = {paddle1Move, paddle2Move, 0, 0, 0, 0};
+    float paddle1Start = player1.pixelY;
+    float paddle2Start = player2.pixelY;
+    // fraction of the step already gone
+    float done = 0;
+    for (int bounce = 0; bounce < BALL_MAX_BOUNCES && done < 1; ++bounce) {
+        float remaining = 1 - done;
+        player1.pixelY = paddle1Start + paddle1Move * done;
+        player2.pixelY = paddle2Start + paddle2Move * done;
+        float dx = ball.velocityX * elapsed * remaining;
+        float dy = ball.velocityY * elapsed * remaining;
+        int hit = -1;
+        float hitTime = 1;
+        float normalX = 0;
+        float normalY = 0;
+        for (int i = 0; i < OBSTACLE_COUNT; ++i) {
+            float time;
+            float nx;
+            float ny;
+            // relative to the obstacle, so a paddle moving into the ball counts
+            if (ball.sweep(*obstacles[i], dx, dy - obstacleMoves[i] * remaining, time, nx, ny) && time < hitTime) {
+                hit = i;
+                hitTime = time;
+                normalX = nx;
+                normalY = ny;
+            }
+        }
+        if (hit < 0) {
+            ball.pixelX += dx;
+            ball.pixelY += dy;
+            break;
+        }
+        ball.pixelX += dx * hitTime;
+        ball.pixelY += dy * hitTime;
+        done += remaining * hitTime;
+        float obstacleVelocityY = obstacleMoves[hit] / elapsed;
+        if (hit == LEFT_GOAL || hit == RIGHT_GOAL) {
+            std::cout << (hit == LEFT_GOAL ? "Player2 wins!" : "Player1 wins!");
+            ball.reset();
+            ball.velocityX = hit == LEFT_GOAL ? -300 : 300;
+            player1.reset();
+            player2.reset();
+            return;
+        } else if (hit == PADDLE1 || hit == PADDLE2) {
+            if (normalX != 0) {
+                ball.velocityX *= -1.1;
+                ball.velocityY = (obstacleVelocityY * 1.1 + ball.velocityY) / 2;
+            } else if (normalY != 0) {
+                // off the paddle's end, bounce away from it at its speed
+                ball.velocityY = 2 * obstacleVelocityY - ball.velocityY;
+            }
+        } else {
+            // reflect off whichever face was hit
+            if (normalX != 0) {
+                ball.velocityX *= -1;
+            }
+            if (normalY != 0) {
+                ball.velocityY *= -1;
+            }
+        }
+    }
+    player1.pixelY = paddle1Start + paddle1Move;
+    player2.pixelY = paddle2Start + paddle2Move;
+}
+
+void Update(float elapsed) {
+    player1.savePosition();
+    player2.savePosition();
+    ball.savePosition();
     
     if (!(player1.checkCollision(upperWall, elapsed)) && !(player1.checkCollision(lowerWall, elapsed))) {
         player1.pixelX += player1.velocityX * elapsed;
@@ -174,58 +310,88 @@ void Update() {
         player2.pixelX += player2.velocityX * elapsed;
         player2.pixelY += player2.velocityY * elapsed;
     }
-    if (ball.checkCollision(player1, elapsed)) {
-        ball.velocityX *= -1.1;
-        ball.velocityY = (player1.velocityY * 1.1 + ball.velocityY) / 2;
-    } else if (ball.checkCollision(player2, elapsed)) {
-        ball.velocityX *= -1.1;
-        ball.velocityY = (player2.velocityY * 1.1 + ball.velocityY) / 2;
-    } else if (ball.checkCollision(leftGoal, elapsed)) {
-        std::cout << "Player2 wins!";
-        ball.reset();
-        ball.velocityX = -300;
-        player1.reset();
-        player2.reset();
-    } else if (ball.checkCollision(rightGoal, elapsed)) {
-        std::cout << "Player1 wins!";
-        ball.reset();
-        ball.velocityX = 300;
-        player1.reset();
-        player2.reset();
-    } else if (ball.checkCollision(upperWall, elapsed) || ball.checkCollision(lowerWall, elapsed)) {
-        ball.velocityY *= -1;
-    } else {
-        ball.pixelX += ball.velocityX * elapsed;
-        ball.pixelY += ball.velocityY * elapsed;
-    }
+    // Paddles and ball all move over the same step, the ball is swept
+    // against where the paddles are at each moment of it
+    float paddle1Move = player1.pixelY - player1.previousPixelY;
+    float paddle2Move = player2.pixelY - player2.previousPixelY;
+    player1.pixelY = player1.previousPixelY;
+    player2.pixelY = player2.previousPixelY;
+    moveBall(elapsed, paddle1Move, paddle2Move);
 }
 
-void Render() {
+void Render(float alpha) {
     // Clearing screen
     glClearColor(0.05, 0.08, 0.12, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
     // Draw
-    player1.draw(program);
-    player2.draw(program);
-    ball.draw(program);
-    upperWall.draw(program);
-    lowerWall.draw(program);
+    player1.draw(program, alpha);
+    player2.draw(program, alpha);
+    ball.draw(program, alpha);
+    upperWall.draw(program, alpha);
+    lowerWall.draw(program, alpha);
     // glDisables
-    glDisableVertexAttribArray(program.positionAttribute);
+    GLState::DisableVertexAttribArray(program.positionAttribute);
     // Display
     SDL_GL_SwapWindow(displayWindow);
 }
 
+// Plays steps updates with paddles as tall as the field, so the ball should
+// never get past one, on random step lengths up to a tenth of a second. The
+// ball keeps speeding up on every hit until it crosses the field several
+// times a step. Any goal, or the ball ending a step inside a wall or paddle,
+// means it went through something.
+int RunStress(int steps) {
+    player1.pixelHeight = 680;
+    player2.pixelHeight = 680;
+    ball.velocityX = -300;
+    ball.velocityY = 170;
+    int escapes = 0;
+    int hits = 0;
+    float fastest = 0;
+    for (int step = 0; step < steps; ++step) {
+        float elapsed = 0.001f + 0.099f * rand() / RAND_MAX;
+        float velocityX = ball.velocityX;
+        Update(elapsed);
+        bool scored = ball.pixelX == 480 && ball.pixelY == 360 && ball.velocityY == 0;
+        bool inside = ball.pixelX >= 40 - 0.01f && ball.pixelX <= 920 + 0.01f &&
+                      ball.pixelY >= 30 - 0.01f && ball.pixelY <= 690 + 0.01f;
+        if (scored || !inside) {
+            escapes++;
+            ball.reset();
+            ball.velocityX = -300;
+        }
+        if ((velocityX < 0) != (ball.velocityX < 0)) {
+            hits++;
+        }
+        fastest = fmaxf(fastest, fabs(ball.velocityX));
+        // start over before floats run out of precision
+        if (fabs(ball.velocityX) > 1e6f || ball.velocityY == 0) {
+            ball.velocityX = ball.velocityX < 0 ? -300 : 300;
+            ball.velocityY = 170;
+        }
+    }
+    std::cout << steps << " steps, " << hits << " paddle hits, fastest " << fastest << " px/s, "
+              << escapes << " escapes" << std::endl;
+    return escapes == 0 ? 0 : 1;
+}
+
 // Main
 int main(int argc, char *argv[]) {
+    // --stress [steps] checks the ball never goes through anything
+    if (argc >= 2 && std::string(argv[1]) == "--stress") {
+        return RunStress(argc >= 3 ? atoi(argv[2]) : 100000);
+    }
     Setup();
 #ifdef _WINDOWS
     glewInit();
 #endif
-    while (!gameDone) {
-        ProcessEvents();
-        Update();
-        Render();
+    GameLoop loop(FIXED_TIMESTEP);
+    loop.Run(gameDone, ProcessEvents, Update, Render);
+    loop.PrintStats();
+    Profiler::PrintFrameStats();
+    std::string profilePrefix = Profiler::CapturePrefix(argc, argv);
+    if (!profilePrefix.empty()) {
+        Profiler::WriteCapture(profilePrefix);
     }
     SDL_Quit();
     return 0;
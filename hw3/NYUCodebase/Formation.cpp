@@ -0,0 +1,73 @@
+#include "Formation.h"
+#include <algorithm>
+
+Formation::Formation(float enemyWidth, float enemyHeight)
+    : offset(0, 0), velocity(0, 0), enemyWidth(enemyWidth), enemyHeight(enemyHeight),
+      minX(0), maxX(0), minY(0), maxY(0) {}
+
+void Formation::Add(float x, float y) {
+    float newX = x - offset.x;
+    float newY = y - offset.y;
+    if (localX.empty()) {
+        minX = maxX = newX;
+        minY = maxY = newY;
+    } else {
+        minX = std::min(minX, newX);
+        maxX = std::max(maxX, newX);
+        minY = std::min(minY, newY);
+        maxY = std::max(maxY, newY);
+    }
+    localX.push_back(newX);
+    localY.push_back(newY);
+}
+
+void Formation::Remove(int index) {
+    bool onEdge = localX[index] == minX || localX[index] == maxX ||
+                  localY[index] == minY || localY[index] == maxY;
+    localX[index] = localX.back();
+    localY[index] = localY.back();
+    localX.pop_back();
+    localY.pop_back();
+    if (onEdge) {
+        UpdateBounds();
+    }
+}
+
+void Formation::Clear() {
+    localX.clear();
+    localY.clear();
+    offset = glm::vec2(0, 0);
+    velocity = glm::vec2(0, 0);
+    minX = maxX = minY = maxY = 0;
+}
+
+void Formation::UpdateBounds() {
+    if (localX.empty()) {
+        minX = maxX = minY = maxY = 0;
+        return;
+    }
+    minX = *std::min_element(localX.begin(), localX.end());
+    maxX = *std::max_element(localX.begin(), localX.end());
+    minY = *std::min_element(localY.begin(), localY.end());
+    maxY = *std::max_element(localY.begin(), localY.end());
+}
+
+void Formation::WorldPositions(std::vector<float> &x, std::vector<float> &y) const {
+    int count = Count();
+    x.resize(count);
+    y.resize(count);
+    // a single add per coordinate over contiguous arrays, which the compiler
+    // turns into packed SIMD adds
+    const float *__restrict inX = localX.data();
+    const float *__restrict inY = localY.data();
+    float *__restrict outX = x.data();
+    float *__restrict outY = y.data();
+    float offsetX = offset.x;
+    float offsetY = offset.y;
+    for (int i = 0; i < count; i++) {
+        outX[i] = inX[i] + offsetX;
+    }
+    for (int i = 0; i < count; i++) {
+        outY[i] = inY[i] + offsetY;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "glm/vec2.hpp"
+
+// The enemy swarm. Enemies only ever move together, so the formation holds one
+// shared offset and velocity, and each enemy only its place within the
+// formation, kept as parallel arrays of local x and y. The extent of the local
+// positions is cached and only recomputed when an enemy on its edge is
+// removed, so edge checks don't touch every enemy each tick.
+class Formation {
+	public:
+		Formation(float enemyWidth = 60, float enemyHeight = 60);
+
+		// adds an enemy centred at world x, y
+		void Add(float x, float y);
+		// moves the last enemy into index's place
+		void Remove(int index);
+		void Clear();
+		int Count() const { return (int)localX.size(); }
+
+		// extent of the enemies' centres, in world space
+		float Left() const { return offset.x + minX; }
+		float Right() const { return offset.x + maxX; }
+		float Top() const { return offset.y + minY; }
+		float Bottom() const { return offset.y + maxY; }
+
+		void Update(float elapsed) { offset += velocity * elapsed; }
+		// world positions of every enemy, resized to Count()
+		void WorldPositions(std::vector<float> &x, std::vector<float> &y) const;
+
+		glm::vec2 offset;
+		glm::vec2 velocity;
+		float enemyWidth;
+		float enemyHeight;
+		std::vector<float> localX;
+		std::vector<float> localY;
+
+	private:
+		void UpdateBounds();
+
+		float minX;
+		float maxX;
+		float minY;
+		float maxY;
+};
@@ -0,0 +1,178 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+bool Profiler::enabled = true;
+unsigned long long Profiler::frameStart = 0;
+bool Profiler::frameRecorded = false;
+float Profiler::frameTimes[PROFILE_FRAME_WINDOW];
+int Profiler::frameCount = 0;
+
+// every thread's buffer, only locked when a thread registers or on export
+static std::mutex bufferListMutex;
+static std::vector<ProfileBuffer*> bufferList;
+
+ProfileBuffer::ProfileBuffer(int threadIndex) : head(0), threadIndex(threadIndex), depth(0) {}
+
+unsigned long long Profiler::Now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+ProfileBuffer *Profiler::ThreadBuffer() {
+    static thread_local ProfileBuffer *buffer = NULL;
+    if (buffer == NULL) {
+        std::lock_guard<std::mutex> lock(bufferListMutex);
+        // never freed: samples have to outlive the thread for export
+        buffer = new ProfileBuffer((int)bufferList.size());
+        bufferList.push_back(buffer);
+    }
+    return buffer;
+}
+
+void Profiler::Record(const char *name, unsigned long long start, unsigned long long end, int depth) {
+    ProfileBuffer *buffer = ThreadBuffer();
+    unsigned long long head = buffer->head.load(std::memory_order_relaxed);
+    ProfileSample &sample = buffer->samples[head % PROFILE_BUFFER_SIZE];
+    sample.name = name;
+    sample.start = start;
+    sample.end = end;
+    sample.depth = depth;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::BeginFrame() {
+    // zones inside the frame nest one level below it
+    frameRecorded = enabled;
+    if (frameRecorded) {
+        ThreadBuffer()->depth++;
+    }
+    frameStart = Now();
+}
+
+void Profiler::EndFrame() {
+    unsigned long long end = Now();
+    if (frameRecorded) {
+        ProfileBuffer *buffer = ThreadBuffer();
+        buffer->depth--;
+        Record("Frame", frameStart, end, buffer->depth);
+    }
+    frameTimes[frameCount % PROFILE_FRAME_WINDOW] = (float)((end - frameStart) / 1000000.0);
+    frameCount++;
+}
+
+double Profiler::FramePercentile(double percentile) {
+    int count = std::min(frameCount, PROFILE_FRAME_WINDOW);
+    if (count == 0) {
+        return 0.0;
+    }
+    std::vector<float> sorted(frameTimes, frameTimes + count);
+    size_t index = std::min((size_t)(percentile / 100.0 * count), (size_t)count - 1);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+void Profiler::PrintFrameStats() {
+    std::cout << "Frame time (last " << std::min(frameCount, PROFILE_FRAME_WINDOW) << " frames): p50 "
+              << FramePercentile(50.0) << " ms, p95 " << FramePercentile(95.0) << " ms, p99 "
+              << FramePercentile(99.0) << " ms" << std::endl;
+}
+
+void Profiler::CollectSamples(std::vector<ProfileSample> &samples, std::vector<int> &threads) {
+    std::lock_guard<std::mutex> lock(bufferListMutex);
+    for (size_t i = 0; i < bufferList.size(); i++) {
+        ProfileBuffer *buffer = bufferList[i];
+        unsigned long long head = buffer->head.load(std::memory_order_acquire);
+        unsigned long long count = std::min(head, (unsigned long long)PROFILE_BUFFER_SIZE);
+        size_t first = samples.size();
+        for (unsigned long long j = head - count; j < head; j++) {
+            samples.push_back(buffer->samples[j % PROFILE_BUFFER_SIZE]);
+        }
+        // the owner may have wrapped around while we copied; anything it could
+        // have overwritten since (including the slot it is writing right now,
+        // which head doesn't cover yet) is dropped rather than exported torn
+        std::atomic_thread_fence(std::memory_order_acquire);
+        unsigned long long after = buffer->head.load(std::memory_order_relaxed);
+        unsigned long long oldest = after + 1 > PROFILE_BUFFER_SIZE ? after + 1 - PROFILE_BUFFER_SIZE : 0;
+        if (oldest > head - count) {
+            unsigned long long overwritten = std::min(oldest - (head - count), count);
+            samples.erase(samples.begin() + first, samples.begin() + first + (size_t)overwritten);
+        }
+        threads.resize(samples.size(), buffer->threadIndex);
+    }
+}
+
+bool Profiler::WriteChromeTrace(const std::string &path) {
+    std::ofstream file(path.c_str());
+    if (!file) {
+        std::cout << "Unable to write profile to " << path << std::endl;
+        return false;
+    }
+    std::vector<ProfileSample> samples;
+    std::vector<int> threads;
+    CollectSamples(samples, threads);
+    // complete ("X") events, timestamps in microseconds
+    file << "{\"traceEvents\":[";
+    for (size_t i = 0; i < samples.size(); i++) {
+        file << (i > 0 ? ",\n" : "\n");
+        file << "{\"name\":\"" << samples[i].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threads[i]
+             << ",\"ts\":" << samples[i].start / 1000.0
+             << ",\"dur\":" << (samples[i].end - samples[i].start) / 1000.0 << "}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return true;
+}
+
+bool Profiler::WriteCSV(const std::string &path) {
+    std::ofstream file(path.c_str());
+    if (!file) {
+        std::cout << "Unable to write profile to " << path << std::endl;
+        return false;
+    }
+    std::vector<ProfileSample> samples;
+    std::vector<int> threads;
+    CollectSamples(samples, threads);
+    file << "thread,name,depth,start_us,duration_us\n";
+    for (size_t i = 0; i < samples.size(); i++) {
+        file << threads[i] << "," << samples[i].name << "," << samples[i].depth << ","
+             << samples[i].start / 1000.0 << "," << (samples[i].end - samples[i].start) / 1000.0 << "\n";
+    }
+    return true;
+}
+
+void Profiler::WriteCapture(const std::string &prefix) {
+    if (WriteChromeTrace(prefix + ".json") && WriteCSV(prefix + ".csv")) {
+        std::cout << "Profile written to " << prefix << ".json and " << prefix << ".csv" << std::endl;
+    }
+}
+
+std::string Profiler::CapturePrefix(int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) {
+            return argv[i + 1];
+        }
+    }
+    return "";
+}
+
+ProfileScope::ProfileScope(const char *name) : name(name), start(0) {
+    if (Profiler::enabled) {
+        Profiler::ThreadBuffer()->depth++;
+        start = Profiler::Now();
+    } else {
+        this->name = NULL;
+    }
+}
+
+ProfileScope::~ProfileScope() {
+    if (name != NULL) {
+        unsigned long long end = Profiler::Now();
+        ProfileBuffer *buffer = Profiler::ThreadBuffer();
+        buffer->depth--;
+        Profiler::Record(name, start, end, buffer->depth);
+    }
+}
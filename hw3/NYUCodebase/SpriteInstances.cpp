@@ -0,0 +1,90 @@
+#include "SpriteInstances.h"
+#include <SDL.h>
+
+// centre x, y and size in GL units, then u, v, width, height of the region
+#define FLOATS_PER_INSTANCE 8
+
+SpriteInstances::SpriteInstances() : rectAttribute(0), regionAttribute(0), instanced(false),
+    drawCalls(0), spriteCount(0), quadBuffer(0), instanceBuffer(0) {}
+
+void SpriteInstances::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
+    program.Load(vertexShaderFile, fragmentShaderFile);
+    rectAttribute = glGetAttribLocation(program.programID, "instanceRect");
+    regionAttribute = glGetAttribLocation(program.programID, "instanceRegion");
+    instanced = SDL_GL_ExtensionSupported("GL_ARB_instanced_arrays") == SDL_TRUE &&
+                SDL_GL_ExtensionSupported("GL_ARB_draw_instanced") == SDL_TRUE;
+
+    // the same two triangles every sprite in the games is drawn with
+    float vertices[] = {0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, 0.5};
+    glGenBuffers(1, &quadBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    instanceData.reserve(256 * FLOATS_PER_INSTANCE);
+}
+
+void SpriteInstances::Cleanup() {
+    glDeleteBuffers(1, &quadBuffer);
+    glDeleteBuffers(1, &instanceBuffer);
+    program.Cleanup();
+}
+
+void SpriteInstances::Add(float x, float y, float width, float height, const AtlasRegion &region) {
+    instanceData.insert(instanceData.end(), {
+        (x / 960) * 2.666f - 1.333f,
+        ((720 - y) / 720) * 2.0f - 1.0f,
+        (width / 960) * 2.666f,
+        (height / 720) * 2.0f,
+        region.u, region.v, region.width, region.height
+    });
+}
+
+void SpriteInstances::Draw(GLuint texture) {
+    if (instanceData.empty()) {
+        return;
+    }
+    GLsizei count = (GLsizei)(instanceData.size() / FLOATS_PER_INSTANCE);
+    program.Use();
+    GLState::BindTexture(texture);
+    glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+    glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, (void *)0);
+    GLState::EnableVertexAttribArray(program.positionAttribute);
+    if (instanced) {
+        GLsizei stride = FLOATS_PER_INSTANCE * sizeof(float);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        // respecify the whole store every frame so the driver can orphan the old one
+        glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(float), instanceData.data(), GL_STREAM_DRAW);
+        glVertexAttribPointer(rectAttribute, 4, GL_FLOAT, false, stride, (void *)0);
+        glVertexAttribPointer(regionAttribute, 4, GL_FLOAT, false, stride, (void *)(4 * sizeof(float)));
+        glVertexAttribDivisorARB(rectAttribute, 1);
+        glVertexAttribDivisorARB(regionAttribute, 1);
+        GLState::EnableVertexAttribArray(rectAttribute);
+        GLState::EnableVertexAttribArray(regionAttribute);
+        GLState::DrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+        // attribute locations are shared with every other program, which all
+        // expect one value per vertex
+        glVertexAttribDivisorARB(rectAttribute, 0);
+        glVertexAttribDivisorARB(regionAttribute, 0);
+        GLState::DisableVertexAttribArray(rectAttribute);
+        GLState::DisableVertexAttribArray(regionAttribute);
+        drawCalls++;
+    } else {
+        // constant attribute values stand in for the per instance arrays
+        GLState::DisableVertexAttribArray(rectAttribute);
+        GLState::DisableVertexAttribArray(regionAttribute);
+        for (GLsizei i = 0; i < count; ++i) {
+            const float *instance = &instanceData[i * FLOATS_PER_INSTANCE];
+            glVertexAttrib4fv(rectAttribute, instance);
+            glVertexAttrib4fv(regionAttribute, instance + 4);
+            GLState::DrawArrays(GL_TRIANGLES, 0, 6);
+        }
+        drawCalls += count;
+    }
+    GLState::DisableVertexAttribArray(program.positionAttribute);
+    // everything else still draws from client-side arrays
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    spriteCount += count;
+    instanceData.clear();
+}
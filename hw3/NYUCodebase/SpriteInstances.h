@@ -0,0 +1,47 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "ShaderProgram.h"
+#include "TextureAtlas.h"
+
+// Draws many sprites from one texture with a single instanced draw call. The
+// unit quad lives in a static buffer; every sprite adds one instance to a
+// streamed buffer holding its centre and size in GL units and its atlas
+// region, and the vertex shader places and textures each corner from those,
+// so nothing per sprite is built or uploaded as a matrix.
+//
+// Needs ARB_instanced_arrays and ARB_draw_instanced. Without either Draw()
+// falls back to one glDrawArrays per sprite, feeding the instance values as
+// constant attributes.
+class SpriteInstances {
+	public:
+		SpriteInstances();
+
+		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
+		void Cleanup();
+
+		// queues a sprite centred at x, y, in pixels from the top left of the
+		// 960x720 screen
+		void Add(float x, float y, float width, float height, const AtlasRegion &region);
+		// draws everything queued since the last Draw
+		void Draw(GLuint texture);
+
+		ShaderProgram program;
+		GLuint rectAttribute;
+		GLuint regionAttribute;
+		bool instanced;
+
+		// totals since Load
+		unsigned long drawCalls;
+		unsigned long spriteCount;
+
+	private:
+		GLuint quadBuffer;
+		GLuint instanceBuffer;
+		std::vector<float> instanceData;
+};
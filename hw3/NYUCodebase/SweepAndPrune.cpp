@@ -0,0 +1,55 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+
+static bool MinXLess(const CollisionBox &a, const CollisionBox &b) {
+    return a.minX < b.minX;
+}
+
+// drops the boxes the sweep line has passed, keeping the rest in order
+static void Prune(std::vector<const CollisionBox*> &active, float x) {
+    size_t kept = 0;
+    for (size_t i = 0; i < active.size(); i++) {
+        if (active[i]->maxX > x) {
+            active[kept++] = active[i];
+        }
+    }
+    active.resize(kept);
+}
+
+void SweepAndPrune::FindPairs(std::vector<CollisionBox> &a, std::vector<CollisionBox> &b,
+                              std::vector<std::pair<int, int> > &pairs) {
+    pairs.clear();
+    tests = 0;
+    std::sort(a.begin(), a.end(), MinXLess);
+    std::sort(b.begin(), b.end(), MinXLess);
+    activeA.clear();
+    activeB.clear();
+    size_t i = 0;
+    size_t j = 0;
+    // each box is tested against the other set's boxes that started before it
+    // and haven't ended yet, so every pair comes up exactly once
+    while (i < a.size() || j < b.size()) {
+        if (j == b.size() || (i < a.size() && a[i].minX <= b[j].minX)) {
+            const CollisionBox &box = a[i++];
+            Prune(activeB, box.minX);
+            for (const CollisionBox *other : activeB) {
+                tests++;
+                if (box.minY < other->maxY && other->minY < box.maxY) {
+                    pairs.push_back(std::make_pair(box.id, other->id));
+                }
+            }
+            activeA.push_back(&box);
+        } else {
+            const CollisionBox &box = b[j++];
+            Prune(activeA, box.minX);
+            for (const CollisionBox *other : activeA) {
+                tests++;
+                if (box.minY < other->maxY && other->minY < box.maxY) {
+                    pairs.push_back(std::make_pair(other->id, box.id));
+                }
+            }
+            activeB.push_back(&box);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+}
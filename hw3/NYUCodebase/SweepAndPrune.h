@@ -0,0 +1,34 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+struct CollisionBox {
+	float minX;
+	float minY;
+	float maxX;
+	float maxY;
+	// caller's index for the box, e.g. into its vector of enemies
+	int id;
+};
+
+// Finds every overlapping pair between two sets of boxes (bullets and
+// enemies, say) by sorting both along x and sweeping across them, keeping a
+// short list of the boxes the sweep line is currently inside. Only boxes that
+// overlap in x are ever tested in y, so with the sets spread out sideways
+// it's close to linear instead of one test per possible pair. Boxes that
+// only touch don't overlap.
+class SweepAndPrune {
+	public:
+		// a and b are sorted in place. pairs gets (a id, b id) for every
+		// overlap, sorted.
+		void FindPairs(std::vector<CollisionBox> &a, std::vector<CollisionBox> &b,
+		               std::vector<std::pair<int, int> > &pairs);
+
+		// how many y tests the last FindPairs did
+		long tests;
+
+	private:
+		std::vector<const CollisionBox*> activeA;
+		std::vector<const CollisionBox*> activeB;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// where a named sprite lives in the atlas texture
+struct AtlasRegion {
+	// empty, which is also what a failed lookup gives
+	AtlasRegion() : u(0.0f), v(0.0f), width(0.0f), height(0.0f), pixelWidth(0), pixelHeight(0) {}
+
+	// top left corner and size, in texture coordinates
+	float u;
+	float v;
+	float width;
+	float height;
+	int pixelWidth;
+	int pixelHeight;
+};
+
+// One texture holding many sprites, looked up by name. Either pack separate
+// images at startup (AddImage, then Pack), or load a sheet that was packed
+// offline together with its XML description (TexturePacker / Kenney format:
+// <SubTexture name="" x="" y="" width="" height=""/>). Everything drawn from
+// one atlas shares one bound texture, so it can go out in a single draw call.
+class TextureAtlas {
+	public:
+		TextureAtlas();
+
+		void AddImage(const std::string &name, const char *filePath);
+		// RGBA pixels decoded elsewhere, copied in
+		void AddPixels(const std::string &name, const unsigned char *pixels, int width, int height);
+		// skyline packs every added image into the smallest power of two
+		// texture that fits, up to maxSize on a side, and uploads it
+		bool Pack(int padding = 2, int maxSize = 4096);
+
+		bool LoadSheet(const char *texturePath, const char *xmlPath);
+
+		// false, leaving region empty, if there's no sprite with that name
+		bool Region(const std::string &name, AtlasRegion &region) const;
+		// texture coordinates for the two-triangle unit quad the games draw with:
+		// (0.5, 0.5), (-0.5, -0.5), (0.5, -0.5), (-0.5, 0.5), (-0.5, -0.5), (0.5, 0.5)
+		bool TexCoords(const std::string &name, float texCoords[12]) const;
+
+		void Cleanup();
+
+		GLuint texture;
+		int width;
+		int height;
+		std::map<std::string, AtlasRegion> regions;
+
+	private:
+		struct Image {
+			std::string name;
+			int width;
+			int height;
+			std::vector<unsigned char> pixels;
+			int x;
+			int y;
+		};
+
+		static bool PackSkyline(std::vector<Image*> &images, int atlasWidth, int atlasHeight, int padding);
+		static GLuint Upload(const unsigned char *pixels, int width, int height);
+
+		std::vector<Image> images;
+};
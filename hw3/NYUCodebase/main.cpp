@@ -5,9 +5,18 @@
 #define GL_GLEXT_PROTOTYPES 1
 #include <SDL_opengl.h>
 #include <SDL_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <vector>
 
 #include "ShaderProgram.h"
+#include "GameLoop.h"
+#include "Profiler.h"
+#include "TextureAtlas.h"
+#include "SweepAndPrune.h"
+#include "Formation.h"
+#include "SpriteInstances.h"
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #define STB_IMAGE_IMPLEMENTATION
@@ -19,6 +28,8 @@
 #define RESOURCE_FOLDER "NYUCodebase.app/Contents/Resources/"
 #endif
 
+#define FIXED_TIMESTEP 0.0166666f
+
 SDL_Window* displayWindow;
 glm::mat4 modelMatrix = glm::mat4(1.0);
 glm::mat4 viewMatrix = glm::mat4(1.0);
@@ -26,10 +37,10 @@ glm::mat4 projectionMatrix = glm::mat4(1.0);
 ShaderProgram program;
 ShaderProgram texProgram;
 bool gameDone = false;
-float lastFrameTicks = 0.0;
 const Uint8 *keys = SDL_GetKeyboardState(NULL);
 GLuint font;
-GLuint spriteSheet;
+TextureAtlas spriteSheet;
+SpriteInstances sprites;
 enum GameMode { TITLE_SCREEN, GAME_LEVEL };
 GameMode mode;
 enum EnemyState { MOVE_LEFT, MOVE_RIGHT, MOVE_DOWN };
@@ -65,15 +76,16 @@ void DrawText(ShaderProgram &program, int fontTexture, std::string text, float s
     }
     glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertexData.data());
     glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoordData.data());
-    glEnableVertexAttribArray(program.positionAttribute);
-    glEnableVertexAttribArray(program.texCoordAttribute);
-    glBindTexture(GL_TEXTURE_2D, fontTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 6 * text.size());
-    glDisableVertexAttribArray(program.positionAttribute);
-    glDisableVertexAttribArray(program.texCoordAttribute);
+    GLState::EnableVertexAttribArray(program.positionAttribute);
+    GLState::EnableVertexAttribArray(program.texCoordAttribute);
+    GLState::BindTexture(fontTexture);
+    GLState::DrawArrays(GL_TRIANGLES, 0, 6 * text.size());
+    GLState::DisableVertexAttribArray(program.positionAttribute);
+    GLState::DisableVertexAttribArray(program.texCoordAttribute);
 }
 
 GLuint LoadTexture(const char *filePath) {
+    PROFILE_SCOPE("LoadTexture");
     int w,h,comp;
     unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
     if (image == NULL) {
@@ -82,7 +94,7 @@ GLuint LoadTexture(const char *filePath) {
     }
     GLuint retTexture;
     glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
+    GLState::BindTexture(retTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -90,7 +102,6 @@ GLuint LoadTexture(const char *filePath) {
     return retTexture;
 }
 
-
 // Game classes
 class Object {
 public:
@@ -107,41 +118,25 @@ public:
 
     GameObject(float x, float y, float width, float height)
     : Object(x, y), size(width, height, 0) {}
-    void draw(ShaderProgram &p, float texCoords[12]) {
-        // Transforming matrix
-        float glX = ((position[0] / 960) * 2.666) - 1.333;
-        float glY = (((720 - position[1]) / 720) * 2.0) - 1.0;
-        float glWidth = (size[0] / 960) * 2.666;
-        float glHeight = (size[1] / 720) * 2.0;
-        glm::mat4 objectModelMatrix = glm::translate(modelMatrix, glm::vec3(glX, glY, 0.0));
-        objectModelMatrix = glm::scale(objectModelMatrix, glm::vec3(glWidth, glHeight, 1.0));
-        p.SetModelMatrix(objectModelMatrix);
-        // Draw
-        float vertices[] = {0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, -0.5, -0.5, 0.5, 0.5};
-        glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-        glEnableVertexAttribArray(p.positionAttribute);
-        glEnableVertexAttribArray(p.texCoordAttribute);
-        glBindTexture(GL_TEXTURE_2D, spriteSheet);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDisableVertexAttribArray(p.positionAttribute);
-        glDisableVertexAttribArray(p.texCoordAttribute);
-    }
-    bool checkCollision(GameObject obj) {
-        if (abs(position[0] - obj.position[0]) < (size[0] + obj.size[0]) / 2 &&
-            abs(position[1] - obj.position[1]) < (size[1] + obj.size[1]) / 2) {
+    bool checkCollision(const GameObject &obj) const {
+        if (fabs(position[0] - obj.position[0]) < (size[0] + obj.size[0]) / 2 &&
+            fabs(position[1] - obj.position[1]) < (size[1] + obj.size[1]) / 2) {
             return true;
         }
         return false;
     }
+    // the same box checkCollision tests, for the broadphase
+    CollisionBox box(int id) const {
+        CollisionBox box = {position[0] - size[0] / 2, position[1] - size[1] / 2,
+                            position[0] + size[0] / 2, position[1] + size[1] / 2, id};
+        return box;
+    }
 };
 
 class Player : public GameObject {
 public:
     Player() : GameObject(480, 660, 70, 70) {}
     
-    float texCoords[12] = {310.0f/1024.0f, 941.0f/1024.0f, 211.0f/1024.0f, 1016.0f/1024.0f, 310.0f/1024.0f, 1016.0f/1024.0f, 211.0f/1024.0f, 941.0f/1024.0f, 211.0f/1024.0f, 1016.0f/1024.0f, 310.0f/1024.0f, 941.0f/1024.0f};
-    
     void reset() {
         position[0] = 480;
         position[1] = 660;
@@ -150,27 +145,24 @@ public:
     }
 };
 
+// unused bullets wait far off to the left
+#define BULLET_PARKED_X -3000
+
 class Bullet : public GameObject {
 public:
-    Bullet() : GameObject(-3000, 0, 10, 40) {}
-    
-    float texCoords[12] = {865.0f/1024.0f, 983.0f/1024.0f, 856.0f/1024.0f, 1020.0f/1024.0f, 865.0f/1024.0f, 1020.0f/1024.0f, 856.0f/1024.0f, 983.0f/1024.0f, 856.0f/1024.0f, 1020.0f/1024.0f, 865.0f/1024.0f, 983.0f/1024.0f};
+    Bullet() : GameObject(BULLET_PARKED_X, 0, 10, 40) {}
+    bool inFlight() const {
+        return position[0] != BULLET_PARKED_X;
+    }
     
     void reset() {
-        position[0] = -3000;
+        position[0] = BULLET_PARKED_X;
         position[1] = 0;
         velocity[0] = 0;
         velocity[1] = 0;
     }
 };
 
-class Enemy : public GameObject {
-public:
-    Enemy(float x, float y, float width, float height) : GameObject(x, y, width, height) {}
-    
-    float texCoords[12] = {535.0f/1024.0f, 0.0f/1024.0f, 444.0f/1024.0f, 91.0f/1024.0f, 535.0f/1024.0f, 91.0f/1024.0f, 444.0f/1024.0f, 0.0f/1024.0f, 444.0f/1024.0f, 91.0f/1024.0f, 535.0f/1024.0f, 0.0f/1024.0f};
-};
-
 class TextBox : public Object {
 public:
     std::string text;
@@ -233,21 +225,37 @@ public:
 class GameLevel {
 public:
     int bulletIndex = 0;
-    Bullet bullets[MAX_BULLETS];
+    std::vector<Bullet> bullets;
     int cooldown = 15;
-    std::vector<Enemy> enemies;
+    Formation enemies;
+    // where every enemy is this tick, from enemies.WorldPositions
+    std::vector<float> enemyX;
+    std::vector<float> enemyY;
     float maxMoveDownTime = 0.5;
     bool goLeft = true;
     Player player;
+    // sprite sheet regions, looked up by name once the sheet is loaded
+    AtlasRegion playerRegion;
+    AtlasRegion bulletRegion;
+    AtlasRegion enemyRegion;
 
-    GameLevel() {
-        for (int i = 0; i < MAX_BULLETS; ++i) {
-            bullets[i] = Bullet();
-        }
+    // scratch space for collideBullets
+    SweepAndPrune broadphase;
+    std::vector<CollisionBox> bulletBoxes;
+    std::vector<CollisionBox> enemyBoxes;
+    std::vector<std::pair<int, int> > hits;
+    std::vector<bool> enemyDead;
+    std::vector<int> deadEnemies;
+
+    GameLevel() : bullets(MAX_BULLETS) {
+        spawnEnemies();
+    }
+    void spawnEnemies() {
+        enemies.Clear();
         for (int i = 0; i < 36; ++i) {
-            enemies.push_back(Enemy(90 * (i % 6 + 1) + 160, 70 * (i / 6 + 1) - 20, 60, 60));
-            enemies[i].velocity[0] = -150;
+            enemies.Add(90 * (i % 6 + 1) + 160, 70 * (i / 6 + 1) - 20);
         }
+        enemies.velocity = glm::vec2(-150, 0);
     }
     void processEvents() {
         SDL_Event event;
@@ -272,122 +280,153 @@ public:
     }
     void update(float elapsed) {
         // Check game over
-        for (int i = 0; i < enemies.size(); ++i) {
-            if (enemies[i].checkCollision(player) ||
-                enemies[i].position[1] + enemies[i].size[1] >= 720) {
-                std::cout << "Game Over" << std::endl;
-                reset();
-                mode = TITLE_SCREEN;
+        enemies.WorldPositions(enemyX, enemyY);
+        bool gameOver = enemies.Count() > 0 && enemies.Bottom() + enemies.enemyHeight >= 720;
+        // only look at single enemies once the player is level with the formation
+        if (!gameOver && enemies.Count() > 0 && player.position[1] - player.size[1] / 2 < enemies.Bottom() + enemies.enemyHeight / 2) {
+            for (int i = 0; i < enemies.Count() && !gameOver; ++i) {
+                gameOver = fabs(player.position[0] - enemyX[i]) < (player.size[0] + enemies.enemyWidth) / 2 &&
+                           fabs(player.position[1] - enemyY[i]) < (player.size[1] + enemies.enemyHeight) / 2;
             }
         }
+        if (gameOver) {
+            std::cout << "Game Over" << std::endl;
+            reset();
+            mode = TITLE_SCREEN;
+        }
         // Player
         if (0 < (player.position[0] - player.size[0] + player.velocity[0] * elapsed) && (player.position[0] + player.size[0] + player.velocity[0] * elapsed) < 960) {
             player.position[0] += player.velocity[0] * elapsed;
         }
         // Bullets
-        for (int i = 0; i < MAX_BULLETS; ++i) {
+        for (int i = 0; i < bullets.size(); ++i) {
             if (-200 < bullets[i].position[0] && bullets[i].position[0] < 1160 &&
                 -200 < bullets[i].position[1] && bullets[i].position[1] < 920) {
                 bullets[i].position[1] += bullets[i].velocity[1] * elapsed;
-                for (int j = 0; j < enemies.size(); ++j) {
-                    if (bullets[i].checkCollision(enemies[j])) {
-                        enemies.erase(enemies.begin() + j);
-                        bullets[i].reset();
-                    }
-                }
             } else {
                 bullets[i].reset();
             }
         }
-        // Enemies
+        collideBullets();
+        // Enemies, all moving as one formation; edges are checked against
+        // its cached extent instead of every enemy
+        bool atLeftEdge = enemies.Count() > 0 && enemies.Left() - enemies.enemyWidth <= 0;
+        bool atRightEdge = enemies.Count() > 0 && enemies.Right() + enemies.enemyWidth >= 960;
         switch (state) {
             case MOVE_LEFT:
-                for (int i = 0; i < enemies.size(); ++i) {
-                    enemies[i].velocity[0] = -140;
-                    enemies[i].velocity[1] = 0;
-                    if (enemies[i].position[0] - enemies[i].size[0] <= 0) {
-                        goLeft = false;
-                        state = MOVE_DOWN;
-                    }
+                enemies.velocity = glm::vec2(-140, 0);
+                if (atLeftEdge) {
+                    goLeft = false;
+                    state = MOVE_DOWN;
                 }
                 break;
             case MOVE_RIGHT:
-                for (int i = 0; i < enemies.size(); ++i) {
-                    enemies[i].velocity[0] = 140;
-                    enemies[i].velocity[1] = 0;
-                    if (enemies[i].position[0] + enemies[i].size[0] >= 960) {
-                        goLeft = true;
-                        state = MOVE_DOWN;
-                    }
+                enemies.velocity = glm::vec2(140, 0);
+                if (atRightEdge) {
+                    goLeft = true;
+                    state = MOVE_DOWN;
                 }
                 break;
             case MOVE_DOWN:
                 maxMoveDownTime = maxMoveDownTime - elapsed;
-                for (int i = 0; i < enemies.size(); ++i) {
-                    enemies[i].velocity[0] = 0;
-                    enemies[i].velocity[1] = 100;
-                    if (maxMoveDownTime < 0) {
-                        if (goLeft) {
-                            state = MOVE_LEFT;
-                        } else {
-                            state = MOVE_RIGHT;
-                        }
-                        maxMoveDownTime = 0.5;
+                enemies.velocity = glm::vec2(0, 100);
+                if (maxMoveDownTime < 0) {
+                    if (goLeft) {
+                        state = MOVE_LEFT;
+                    } else {
+                        state = MOVE_RIGHT;
                     }
+                    maxMoveDownTime = 0.5;
                 }
                 break;
         }
-        for (int i = 0; i < enemies.size(); ++i) {
-            if (enemies[i].position[0] - enemies[i].size[0] <= 0) {
-                for (int j = 0; j < enemies.size(); ++j) {
-                    enemies[j].velocity[0] = 150;
-                    enemies[j].velocity[1] = 50;
-                }
-                break;
-            } else if (enemies[i].position[0] + enemies[i].size[0] >= 960) {
-                for (int j = 0; j < enemies.size(); ++j) {
-                    enemies[j].velocity[0] = -150;
-                    enemies[j].velocity[1] = 50;
-                }
-                break;
-            }
-        }
-        for (int i = 0; i < enemies.size(); ++i) {
-            enemies[i].position[0] += enemies[i].velocity[0] * elapsed;
-            enemies[i].position[1] += enemies[i].velocity[1] * elapsed;
+        // step back off an edge
+        if (atLeftEdge) {
+            enemies.velocity = glm::vec2(150, 50);
+        } else if (atRightEdge) {
+            enemies.velocity = glm::vec2(-150, 50);
         }
+        enemies.Update(elapsed);
         if (cooldown > 0) { cooldown -= elapsed; }  // Cooldown working weirdly
-        if (enemies.empty()) {
+        if (enemies.Count() == 0) {
             std::cout << "You Win!" << std::endl;
             reset();
             mode = TITLE_SCREEN;
         }
     }
+    // Each bullet takes out the first enemy it overlaps that isn't already
+    // dead. Dead enemies are swapped with the last one and popped, since the
+    // order of enemies doesn't matter. Returns how many died.
+    int collideBullets() {
+        bulletBoxes.clear();
+        enemyBoxes.clear();
+        for (int i = 0; i < bullets.size(); ++i) {
+            if (bullets[i].inFlight()) {
+                bulletBoxes.push_back(bullets[i].box(i));
+            }
+        }
+        enemies.WorldPositions(enemyX, enemyY);
+        float halfWidth = enemies.enemyWidth / 2;
+        float halfHeight = enemies.enemyHeight / 2;
+        for (int j = 0; j < enemies.Count(); ++j) {
+            CollisionBox box = {enemyX[j] - halfWidth, enemyY[j] - halfHeight, enemyX[j] + halfWidth, enemyY[j] + halfHeight, j};
+            enemyBoxes.push_back(box);
+        }
+        broadphase.FindPairs(bulletBoxes, enemyBoxes, hits);
+        enemyDead.assign(enemies.Count(), false);
+        deadEnemies.clear();
+        // hits are sorted by bullet, then enemy
+        int lastBullet = -1;
+        for (const std::pair<int, int> &hit : hits) {
+            if (hit.first == lastBullet || enemyDead[hit.second]) {
+                continue;
+            }
+            lastBullet = hit.first;
+            enemyDead[hit.second] = true;
+            deadEnemies.push_back(hit.second);
+            bullets[hit.first].reset();
+        }
+        // highest index first, so the enemy swapped into each gap is alive
+        std::sort(deadEnemies.begin(), deadEnemies.end(), std::greater<int>());
+        for (int j : deadEnemies) {
+            enemies.Remove(j);
+        }
+        return (int)deadEnemies.size();
+    }
+    // false if any of the sprites is missing from the sheet
+    bool loadSprites(const TextureAtlas &sheet) {
+        bool player = sheet.Region("playerShip1_blue.png", playerRegion);
+        bool bullet = sheet.Region("laserRed05.png", bulletRegion);
+        bool enemy = sheet.Region("ufoRed.png", enemyRegion);
+        return player && bullet && enemy;
+    }
+    // everything is on the sprite sheet, so the level goes out in one draw call
     void render() {
-        player.draw(texProgram, player.texCoords);
-        for (int i = 0; i < MAX_BULLETS; ++i) {
-            bullets[i].draw(texProgram, bullets[i].texCoords);
+        sprites.Add(player.position[0], player.position[1], player.size[0], player.size[1], playerRegion);
+        for (int i = 0; i < bullets.size(); ++i) {
+            // parked bullets are off screen anyway
+            if (bullets[i].inFlight()) {
+                sprites.Add(bullets[i].position[0], bullets[i].position[1], bullets[i].size[0], bullets[i].size[1], bulletRegion);
+            }
         }
-        for (int i = 0; i < enemies.size(); ++i) {
-            enemies[i].draw(texProgram, enemies[i].texCoords);
+        enemies.WorldPositions(enemyX, enemyY);
+        for (int i = 0; i < enemies.Count(); ++i) {
+            sprites.Add(enemyX[i], enemyY[i], enemies.enemyWidth, enemies.enemyHeight, enemyRegion);
         }
+        sprites.Draw(spriteSheet.texture);
     }
     void shootBullet() {
         bullets[bulletIndex].position[0] = player.position[0];
         bullets[bulletIndex].position[1] = player.position[1];
         bullets[bulletIndex].velocity[1] = -800;
         bulletIndex++;
-        if (bulletIndex > MAX_BULLETS-1) {
+        if (bulletIndex > bullets.size()-1) {
             bulletIndex = 0;
         }
     }
     void reset() {
-        enemies.clear();
-        for (int i = 0; i < 36; ++i) {
-            enemies.push_back(Enemy(90 * (i % 6 + 1) + 160, 70 * (i / 6 + 1) - 20, 60, 60));
-            enemies[i].velocity[0] = -150;
-        }
-        for (int i = 0; i < MAX_BULLETS; ++i) {
+        spawnEnemies();
+        for (int i = 0; i < bullets.size(); ++i) {
             bullets[i].reset();
         }
         player.reset();
@@ -396,30 +435,187 @@ public:
 
 
 // Main function prototypes
-void Setup();
+bool Setup();
 void ProcessEvents();
 void Update(float elapsed);
-void Render();
+void Render(float alpha);
 
 // In-game global variables
 TitleScreen titleScreen;
 GameLevel gameLevel;
 
 
+// Fills a level with enemyCount enemies and bulletCount bullets in flight,
+// at the same density as the real formation, and times collideBullets.
+// Killed enemies and spent bullets are put back somewhere else, so the
+// counts stay the same for every frame.
+int RunStress(int enemyCount, int bulletCount) {
+    const int frames = 120;
+    float scale = sqrtf(enemyCount / 36.0f);
+    float fieldWidth = 960 * scale;
+    float fieldHeight = 720 * scale;
+    auto randomX = [&]() { return (float)rand() / RAND_MAX * fieldWidth; };
+    auto randomY = [&]() { return (float)rand() / RAND_MAX * fieldHeight; };
+    GameLevel level;
+    level.enemies.Clear();
+    for (int i = 0; i < enemyCount; ++i) {
+        level.enemies.Add(randomX(), randomY());
+    }
+    level.bullets.assign(bulletCount, Bullet());
+    for (int i = 0; i < bulletCount; ++i) {
+        level.bullets[i].position[0] = randomX();
+        level.bullets[i].position[1] = randomY();
+        level.bullets[i].velocity[1] = -800;
+    }
+
+    // the old way, every bullet against every enemy, for one frame
+    std::vector<GameObject> enemyObjects;
+    level.enemies.WorldPositions(level.enemyX, level.enemyY);
+    for (int j = 0; j < enemyCount; ++j) {
+        enemyObjects.push_back(GameObject(level.enemyX[j], level.enemyY[j], 60, 60));
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long bruteHits = 0;
+    for (int i = 0; i < bulletCount; ++i) {
+        for (int j = 0; j < enemyCount; ++j) {
+            bruteHits += level.bullets[i].checkCollision(enemyObjects[j]);
+        }
+    }
+    double bruteSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double seconds = 0;
+    long tests = 0;
+    long kills = 0;
+    long overlaps = 0;
+    for (int frame = 0; frame < frames; ++frame) {
+        start = std::chrono::steady_clock::now();
+        kills += level.collideBullets();
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        tests += level.broadphase.tests;
+        if (frame == 0) {
+            overlaps = level.hits.size();
+        }
+        while (level.enemies.Count() < enemyCount) {
+            level.enemies.Add(randomX(), randomY());
+        }
+        for (int i = 0; i < bulletCount; ++i) {
+            Bullet &bullet = level.bullets[i];
+            bullet.position[1] += bullet.velocity[1] * FIXED_TIMESTEP;
+            if (bullet.position[0] < 0 || bullet.position[1] < 0) {
+                bullet.position[0] = randomX();
+                bullet.position[1] = fieldHeight;
+                bullet.velocity[1] = -800;
+            }
+        }
+    }
+    std::cout << enemyCount << " enemies, " << bulletCount << " bullets, " << frames << " frames" << std::endl;
+    std::cout << "Every pair: " << bruteSeconds * 1000.0 << " ms/frame, " << (long)bulletCount * enemyCount
+              << " tests, " << bruteHits << " overlaps" << std::endl;
+    std::cout << "Sort and sweep: " << seconds / frames * 1000.0 << " ms/frame, " << tests / frames
+              << " tests/frame, " << overlaps << " overlaps on the first frame, " << kills / frames << " kills/frame" << std::endl;
+    std::cout << "Throughput: " << (double)bulletCount * enemyCount * frames / seconds / 1e9
+              << "G bullet-enemy pairs resolved per second" << std::endl;
+    if (overlaps != bruteHits) {
+        std::cout << "Sort and sweep missed overlaps" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Times one tick of enemy movement the old way, a GameObject per enemy with
+// its own velocity and an edge scan, velocity pass and integration pass over
+// all of them, against the formation's shared offset plus the world position
+// pass collisions and drawing need.
+int RunFormationBench(int enemyCount) {
+    const int ticks = 2000;
+    std::vector<GameObject> objects;
+    Formation formation;
+    for (int i = 0; i < enemyCount; ++i) {
+        float x = 90 * (i % 6 + 1) + 160;
+        float y = 70 * (i / 6 + 1) - 20;
+        objects.push_back(GameObject(x, y, 60, 60));
+        formation.Add(x, y);
+    }
+    std::vector<float> x;
+    std::vector<float> y;
+    // bounce between the edges so both versions take the same branches
+    float direction = -1;
+    float checksum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; ++tick) {
+        bool atEdge = false;
+        for (const GameObject &object : objects) {
+            if (object.position[0] - object.size[0] <= 0 || object.position[0] + object.size[0] >= 960) {
+                atEdge = true;
+            }
+        }
+        if (atEdge) {
+            direction = tick % 2 ? 1 : -1;
+        }
+        for (GameObject &object : objects) {
+            object.velocity = glm::vec3(140 * direction, 0, 0);
+        }
+        for (GameObject &object : objects) {
+            object.position += object.velocity * FIXED_TIMESTEP;
+        }
+    }
+    double objectSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    checksum += objects[0].position[0];
+
+    direction = -1;
+    start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; ++tick) {
+        if (formation.Left() - formation.enemyWidth <= 0 || formation.Right() + formation.enemyWidth >= 960) {
+            direction = tick % 2 ? 1 : -1;
+        }
+        formation.velocity = glm::vec2(140 * direction, 0);
+        formation.Update(FIXED_TIMESTEP);
+        formation.WorldPositions(x, y);
+    }
+    double formationSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    checksum -= x[0];
+
+    std::cout << enemyCount << " enemies, " << ticks << " ticks" << std::endl;
+    std::cout << "Per enemy: " << objectSeconds / ticks * 1e6 << " us/tick" << std::endl;
+    std::cout << "Formation: " << formationSeconds / ticks * 1e6 << " us/tick" << std::endl;
+    if (fabs(checksum) > 0.01f) {
+        std::cout << "Formation ended up somewhere else: " << checksum << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 // Main
 int main(int argc, char *argv[]) {
-    Setup();
+    // --stress [enemies] [bullets] benchmarks collisions instead of playing
+    if (argc >= 2 && std::string(argv[1]) == "--stress") {
+        return RunStress(argc >= 3 ? atoi(argv[2]) : 10000, argc >= 4 ? atoi(argv[3]) : 10000);
+    }
+    // --bench-formation [enemies] benchmarks enemy movement
+    if (argc >= 2 && std::string(argv[1]) == "--bench-formation") {
+        return RunFormationBench(argc >= 3 ? atoi(argv[2]) : 100000);
+    }
+    if (!Setup()) {
+        sprites.Cleanup();
+        spriteSheet.Cleanup();
+        SDL_Quit();
+        return 1;
+    }
 #ifdef _WINDOWS
     glewInit();
 #endif
-    while (!gameDone) {
-        // Update ticks
-        float ticks = SDL_GetTicks()/1000.0;
-        float elapsed = ticks - lastFrameTicks;
-        lastFrameTicks = ticks;
-        ProcessEvents();
-        Update(elapsed);
-        Render();
+    GameLoop loop(FIXED_TIMESTEP);
+    loop.Run(gameDone, ProcessEvents, Update, Render);
+    loop.PrintStats();
+    std::cout << "Sprites: " << sprites.spriteCount << " in " << sprites.drawCalls << " draw calls"
+              << (sprites.instanced ? "" : " (no instancing)") << std::endl;
+    sprites.Cleanup();
+    spriteSheet.Cleanup();
+    Profiler::PrintFrameStats();
+    std::string profilePrefix = Profiler::CapturePrefix(argc, argv);
+    if (!profilePrefix.empty()) {
+        Profiler::WriteCapture(profilePrefix);
     }
     SDL_Quit();
     return 0;
@@ -427,28 +623,49 @@ int main(int argc, char *argv[]) {
 
 
 // Main functions
-void Setup() {
+// false if the sprite sheet or a sprite the game needs couldn't be loaded
+bool Setup() {
     SDL_Init(SDL_INIT_VIDEO);
     displayWindow = SDL_CreateWindow("Space Invaders", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 960, 720, SDL_WINDOW_OPENGL);
     SDL_GLContext context = SDL_GL_CreateContext(displayWindow);
     SDL_GL_MakeCurrent(displayWindow, context);
     glViewport(0, 0, 960, 720);
     projectionMatrix = glm::ortho(-1.333, 1.333, -1.0, 1.0, -1.0, 1.0);
+    {
+        PROFILE_SCOPE("Load shaders");
+        program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
+        texProgram.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
+        sprites.Load(RESOURCE_FOLDER"vertex_instanced.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
+    }
     // Normal program
-    program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
-    glUseProgram(program.programID);
+    program.Use();
     program.SetProjectionMatrix(projectionMatrix);
     program.SetViewMatrix(viewMatrix);
     // Texture program
-    texProgram.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glUseProgram(texProgram.programID);
+    texProgram.Use();
     texProgram.SetProjectionMatrix(projectionMatrix);
     texProgram.SetViewMatrix(viewMatrix);
+    // Instanced sprite program
+    sprites.program.Use();
+    sprites.program.SetProjectionMatrix(projectionMatrix);
+    sprites.program.SetViewMatrix(viewMatrix);
+    sprites.program.SetModelMatrix(modelMatrix);
     // Textures
     font = LoadTexture(RESOURCE_FOLDER"assets/font.png");
-    spriteSheet = LoadTexture(RESOURCE_FOLDER"assets/spritesheet.png");
+    {
+        PROFILE_SCOPE("LoadSheet");
+        if (!spriteSheet.LoadSheet(RESOURCE_FOLDER"assets/spritesheet.png", RESOURCE_FOLDER"assets/sheet.xml")) {
+            std::cout << "Unable to load the sprite sheet" << std::endl;
+            return false;
+        }
+    }
+    if (!gameLevel.loadSprites(spriteSheet)) {
+        std::cout << "The sprite sheet is missing the player, bullet or enemy sprite" << std::endl;
+        return false;
+    }
+    return true;
 }
 
 void ProcessEvents() {
@@ -473,7 +690,8 @@ void Update(float elapsed) {
     }
 }
 
-void Render() {
+// Objects here move a few pixels per step, so alpha isn't used to interpolate
+void Render(float alpha) {
     // Clearing screen
     glClearColor(0.1, 0.1, 0.1, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
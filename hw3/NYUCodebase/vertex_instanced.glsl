@@ -0,0 +1,19 @@
+attribute vec4 position;
+// centre x, y and width, height in GL units
+attribute vec4 instanceRect;
+// top left u, v and width, height of the atlas region
+attribute vec4 instanceRegion;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+varying vec2 texCoordVar;
+
+void main()
+{
+	vec4 p = vec4(instanceRect.xy + position.xy * instanceRect.zw, 0.0, 1.0);
+	// the quad's top right corner (0.5, 0.5) maps to the region's right, top
+	texCoordVar = instanceRegion.xy + vec2(position.x + 0.5, 0.5 - position.y) * instanceRegion.zw;
+	gl_Position = projectionMatrix * viewMatrix * modelMatrix * p;
+}
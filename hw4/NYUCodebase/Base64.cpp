@@ -0,0 +1,92 @@
+#include "Base64.h"
+
+#define BASE64_INVALID -1
+#define BASE64_SPACE -2
+#define BASE64_PAD -3
+
+struct Base64Table {
+    signed char values[256];
+
+    Base64Table() {
+        for (int i = 0; i < 256; i++) {
+            values[i] = BASE64_INVALID;
+        }
+        const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; i++) {
+            values[(unsigned char)alphabet[i]] = i;
+        }
+        values[(unsigned char)' '] = BASE64_SPACE;
+        values[(unsigned char)'\t'] = BASE64_SPACE;
+        values[(unsigned char)'\n'] = BASE64_SPACE;
+        values[(unsigned char)'\r'] = BASE64_SPACE;
+        values[(unsigned char)'='] = BASE64_PAD;
+    }
+};
+
+static const Base64Table table;
+
+Base64Decoder::Base64Decoder() : bits(0), count(0), padded(false) {}
+
+long Base64Decoder::Decode(const char *in, size_t length, unsigned char *out) {
+    const unsigned char *input = (const unsigned char*)in;
+    const signed char *values = table.values;
+    unsigned char *start = out;
+    size_t i = 0;
+    while (i < length) {
+        if (count == 0 && !padded) {
+            // fast path: whole quads of plain base64, everything special is negative
+            while (i + 4 <= length) {
+                int a = values[input[i]];
+                int b = values[input[i + 1]];
+                int c = values[input[i + 2]];
+                int d = values[input[i + 3]];
+                if ((a | b | c | d) < 0) {
+                    break;
+                }
+                unsigned int quad = (a << 18) | (b << 12) | (c << 6) | d;
+                out[0] = (unsigned char)(quad >> 16);
+                out[1] = (unsigned char)(quad >> 8);
+                out[2] = (unsigned char)quad;
+                out += 3;
+                i += 4;
+            }
+            if (i >= length) {
+                break;
+            }
+        }
+        int value = values[input[i++]];
+        if (value == BASE64_SPACE) {
+            continue;
+        }
+        if (value == BASE64_PAD) {
+            if (count == 1) {
+                return -1;
+            }
+            // "xx==" holds one byte, "xxx=" two
+            if (count == 2) {
+                *out++ = (unsigned char)(bits >> 4);
+            } else if (count == 3) {
+                *out++ = (unsigned char)(bits >> 10);
+                *out++ = (unsigned char)(bits >> 2);
+            }
+            bits = 0;
+            count = 0;
+            padded = true;
+            continue;
+        }
+        if (value < 0 || padded) {
+            return -1;
+        }
+        bits = (bits << 6) | value;
+        count++;
+        if (count == 4) {
+            out[0] = (unsigned char)(bits >> 16);
+            out[1] = (unsigned char)(bits >> 8);
+            out[2] = (unsigned char)bits;
+            out += 3;
+            bits = 0;
+            count = 0;
+        }
+    }
+    return (long)(out - start);
+}
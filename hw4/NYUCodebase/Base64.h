@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+// Incremental base64 decoder. Input can be fed in arbitrary pieces (a quad
+// split across two calls is carried over) and may contain whitespace, like
+// the line-wrapped layer data Tiled writes. Whole quads go through a table
+// lookup four characters at a time, with one validity check per quad.
+class Base64Decoder {
+	public:
+		Base64Decoder();
+
+		// decodes into out, which needs room for MaxDecodedSize(length) bytes.
+		// returns the number of bytes written, or -1 on a character that isn't
+		// base64 or data after the padding.
+		long Decode(const char *in, size_t length, unsigned char *out);
+		// false if the input so far ended partway through a quad
+		bool Finished() const { return count == 0; }
+
+		static size_t MaxDecodedSize(size_t length) { return length / 4 * 3 + 3; }
+
+	private:
+		unsigned int bits;
+		int count;
+		bool padded;
+};
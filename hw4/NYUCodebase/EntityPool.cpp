@@ -0,0 +1,159 @@
+#include "EntityPool.h"
+
+int EntityPool::Add(float entityX, float entityY, float entityWidth, float entityHeight) {
+    x.push_back(entityX);
+    y.push_back(entityY);
+    previousX.push_back(entityX);
+    previousY.push_back(entityY);
+    velocityX.push_back(0);
+    velocityY.push_back(0);
+    accelerationX.push_back(0);
+    accelerationY.push_back(0);
+    width.push_back(entityWidth);
+    height.push_back(entityHeight);
+    groundFriction.push_back(1.0f);
+    flags.push_back(0);
+    return Count() - 1;
+}
+
+void EntityPool::Remove(int index) {
+    int last = Count() - 1;
+    x[index] = x[last];
+    y[index] = y[last];
+    previousX[index] = previousX[last];
+    previousY[index] = previousY[last];
+    velocityX[index] = velocityX[last];
+    velocityY[index] = velocityY[last];
+    accelerationX[index] = accelerationX[last];
+    accelerationY[index] = accelerationY[last];
+    width[index] = width[last];
+    height[index] = height[last];
+    groundFriction[index] = groundFriction[last];
+    flags[index] = flags[last];
+    x.pop_back();
+    y.pop_back();
+    previousX.pop_back();
+    previousY.pop_back();
+    velocityX.pop_back();
+    velocityY.pop_back();
+    accelerationX.pop_back();
+    accelerationY.pop_back();
+    width.pop_back();
+    height.pop_back();
+    groundFriction.pop_back();
+    flags.pop_back();
+}
+
+void EntityPool::Clear() {
+    x.clear();
+    y.clear();
+    previousX.clear();
+    previousY.clear();
+    velocityX.clear();
+    velocityY.clear();
+    accelerationX.clear();
+    accelerationY.clear();
+    width.clear();
+    height.clear();
+    groundFriction.clear();
+    flags.clear();
+}
+
+void EntityPool::Reserve(int count) {
+    x.reserve(count);
+    y.reserve(count);
+    previousX.reserve(count);
+    previousY.reserve(count);
+    velocityX.reserve(count);
+    velocityY.reserve(count);
+    accelerationX.reserve(count);
+    accelerationY.reserve(count);
+    width.reserve(count);
+    height.reserve(count);
+    groundFriction.reserve(count);
+    flags.reserve(count);
+}
+
+void EntityPool::Update(float elapsed, const TileCollider &collider, float gravityY, float frictionX, float frictionY) {
+    int count = Count();
+    previousX = x;
+    previousY = y;
+    tileX.resize(count);
+    tileY.resize(count);
+    halfWidth.resize(count);
+    halfHeight.resize(count);
+    moveX.resize(count);
+    moveY.resize(count);
+    // plain pointers, so the compiler knows the loops below don't alias
+    float *__restrict px = x.data();
+    float *__restrict py = y.data();
+    float *__restrict vx = velocityX.data();
+    float *__restrict vy = velocityY.data();
+    const float *__restrict ax = accelerationX.data();
+    const float *__restrict ay = accelerationY.data();
+    const float *__restrict w = width.data();
+    const float *__restrict h = height.data();
+    float *__restrict friction = groundFriction.data();
+    uint8_t *__restrict entityFlags = flags.data();
+    float *__restrict tx = tileX.data();
+    float *__restrict ty = tileY.data();
+    float *__restrict hw = halfWidth.data();
+    float *__restrict hh = halfHeight.data();
+    float *__restrict mx = moveX.data();
+    float *__restrict my = moveY.data();
+
+    // friction only when on ground; lerp(v, 0, t) is v * (1 - t)
+    for (int i = 0; i < count; i++) {
+        float grounded = (entityFlags[i] & ENTITY_COLLIDED_BOTTOM) ? 1.0f : 0.0f;
+        vx[i] *= 1.0f - grounded * elapsed * frictionX * friction[i];
+        vy[i] *= 1.0f - grounded * elapsed * frictionY * friction[i];
+    }
+    // integrate, and convert boxes and motion to the collider's tile space
+    // (y down) here rather than once per entity inside Move
+    float tileSize = collider.tileSize;
+    float scale = 1.0f / tileSize;
+    for (int i = 0; i < count; i++) {
+        vx[i] += ax[i] * elapsed;
+        vy[i] += (gravityY + ay[i]) * elapsed;
+        tx[i] = px[i] * scale;
+        ty[i] = -py[i] * scale;
+        hw[i] = w[i] * scale * 0.5f;
+        hh[i] = h[i] * scale * 0.5f;
+        mx[i] = vx[i] * elapsed * scale;
+        my[i] = -vy[i] * elapsed * scale;
+    }
+
+    // the collision pass is per entity, it branches on what each one hits
+    const FlareMap &map = *collider.map;
+    for (int i = 0; i < count; i++) {
+        TileMove move = collider.MoveTiles(tx[i], ty[i], hw[i], hh[i], mx[i], my[i]);
+        tx[i] = move.x;
+        ty[i] = move.y;
+        uint8_t result = (move.collidedTop ? ENTITY_COLLIDED_TOP : 0) |
+            (move.collidedBottom ? ENTITY_COLLIDED_BOTTOM : 0) |
+            (move.collidedLeft ? ENTITY_COLLIDED_LEFT : 0) |
+            (move.collidedRight ? ENTITY_COLLIDED_RIGHT : 0);
+        for (int c = 0; c < move.contactCount; c++) {
+            const TileContact &contact = move.contacts[c];
+            if (contact.normalX != 0) {
+                vx[i] = 0;
+            } else {
+                vy[i] = 0;
+            }
+            if (contact.normalY > 0) {
+                friction[i] = map.TileProperties(contact.tileX, contact.tileY).friction;
+            }
+        }
+        // hazards hurt when the body or the feet are in one
+        int gridX = (int)tx[i];
+        if (map.hazard.Test(gridX, (int)ty[i]) || map.hazard.Test(gridX, (int)(ty[i] + hh[i]))) {
+            result |= ENTITY_TOUCHED_HAZARD;
+        }
+        entityFlags[i] = result;
+    }
+
+    for (int i = 0; i < count; i++) {
+        px[i] = tx[i] * tileSize;
+        py[i] = -ty[i] * tileSize;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "TileCollider.h"
+
+#define ENTITY_COLLIDED_TOP 1
+#define ENTITY_COLLIDED_BOTTOM 2
+#define ENTITY_COLLIDED_LEFT 4
+#define ENTITY_COLLIDED_RIGHT 8
+#define ENTITY_TOUCHED_HAZARD 16
+
+// Lots of simple tile-map entities (NPCs, pickups) stored as parallel arrays,
+// one per field, instead of one object per entity. Update runs each stage
+// over every entity in its own loop, so each loop only streams the fields it
+// uses and the integration loops vectorize. Entities are addressed by index;
+// Remove moves the last entity into the gap.
+class EntityPool {
+	public:
+		int Add(float x, float y, float width, float height);
+		void Remove(int index);
+		void Clear();
+		void Reserve(int count);
+		int Count() const { return (int)x.size(); }
+
+		// one fixed step for every entity, the same as Entity::update: ground
+		// friction, gravity and acceleration, then a swept move through the tiles
+		void Update(float elapsed, const TileCollider &collider, float gravityY, float frictionX, float frictionY);
+
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> previousX;
+		std::vector<float> previousY;
+		std::vector<float> velocityX;
+		std::vector<float> velocityY;
+		std::vector<float> accelerationX;
+		std::vector<float> accelerationY;
+		std::vector<float> width;
+		std::vector<float> height;
+		// friction of the tile last stood on
+		std::vector<float> groundFriction;
+		// ENTITY_ flags from the last update
+		std::vector<uint8_t> flags;
+
+	private:
+		// scratch space for Update: boxes and this step's motion in tile units
+		std::vector<float> tileX;
+		std::vector<float> tileY;
+		std::vector<float> halfWidth;
+		std::vector<float> halfHeight;
+		std::vector<float> moveX;
+		std::vector<float> moveY;
+};
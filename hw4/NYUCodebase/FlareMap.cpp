@@ -1,22 +1,62 @@
 
 #include "FlareMap.h"
+#include "XmlReader.h"
+#include "Base64.h"
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <string>
 #include <iostream>
 #include <sstream>
-#include <cassert>
+#include <cstring>
 
 FlareMap::FlareMap() {
-	mapData = nullptr;
 	mapWidth = -1;
 	mapHeight = -1;
+	tiles = nullptr;
+	mappedData = nullptr;
+	mappedSize = 0;
 }
 
 FlareMap::~FlareMap() {
-	for(int i=0; i < mapHeight; i++) {
-		delete mapData[i];
+	Release();
+}
+
+FlareMap::FlareMap(FlareMap &&other) {
+	MoveFrom(other);
+}
+
+FlareMap &FlareMap::operator=(FlareMap &&other) {
+	if(this != &other) {
+		Release();
+		MoveFrom(other);
 	}
-	delete mapData;
+	return *this;
+}
+
+void FlareMap::MoveFrom(FlareMap &other) {
+	mapWidth = other.mapWidth;
+	mapHeight = other.mapHeight;
+	entities = std::move(other.entities);
+	tilesets = std::move(other.tilesets);
+	tileProperties = std::move(other.tileProperties);
+	solid = std::move(other.solid);
+	oneWay = std::move(other.oneWay);
+	hazard = std::move(other.hazard);
+	// moving the vector keeps its buffer, so tiles stays valid
+	ownedTiles = std::move(other.ownedTiles);
+	tiles = other.tiles;
+	mappedData = other.mappedData;
+	mappedSize = other.mappedSize;
+	other.mapWidth = -1;
+	other.mapHeight = -1;
+	other.tiles = nullptr;
+	other.mappedData = nullptr;
+	other.mappedSize = 0;
 }
 
 bool FlareMap::ReadHeader(std::ifstream &stream) {
@@ -38,10 +78,8 @@ bool FlareMap::ReadHeader(std::ifstream &stream) {
 	if(mapWidth == -1 || mapHeight == -1) {
 		return false;
 	} else {
-		mapData = new unsigned int*[mapHeight];
-		for(int i = 0; i < mapHeight; ++i) {
-			mapData[i] = new unsigned int[mapWidth];
-		}
+		ownedTiles.assign((size_t)mapWidth * mapHeight, 0);
+		tiles = ownedTiles.data();
 		return true;
 	}
 }
@@ -55,6 +93,10 @@ bool FlareMap::ReadLayerData(std::ifstream &stream) {
 		std::getline(sStream, key, '=');
 		std::getline(sStream, value);
 		if(key == "data") {
+			if(tiles == nullptr) {
+				std::cout << "Layer data comes before the map header\n";
+				return false;
+			}
 			for(int y=0; y < mapHeight; y++) {
 				getline(stream, line);
 				std::istringstream lineStream(line);
@@ -62,10 +104,15 @@ bool FlareMap::ReadLayerData(std::ifstream &stream) {
 				for(int x=0; x < mapWidth; x++) {
 					std::getline(lineStream, tile, ',');
 					unsigned int val = atoi(tile.c_str());
+					// tiles are stored in 16 bits
+					if(val > 0x10000) {
+						std::cout << "Tile " << val << " at " << x << "," << y << " doesn't fit in 16 bits\n";
+						return false;
+					}
 					if(val > 0) {
-						mapData[y][x] = val-1;
+						ownedTiles[y * mapWidth + x] = val-1;
 					} else {
-						mapData[y][x] = 0;
+						ownedTiles[y * mapWidth + x] = 0;
 					}
 				}
 			}
@@ -102,21 +149,460 @@ bool FlareMap::ReadEntityData(std::ifstream &stream) {
 	return true;
 }
 
-void FlareMap::Load(const std::string fileName) {
-	std::ifstream infile(fileName);
+bool FlareMap::Load(const std::string fileName) {
+	std::ifstream infile(fileName, std::ios::binary);
 	if(infile.fail()) {
-		assert(false); // unable to open file
+		std::cout << "Unable to open map " << fileName << "\n";
+		return false;
+	}
+	uint32_t magic = 0;
+	infile.read((char*)&magic, sizeof(magic));
+	if(magic == FLARE_MAP_MAGIC) {
+		infile.close();
+		return LoadBinary(fileName);
+	}
+	// the text export starts with "[header]", a .tmx with "<?xml" or "<map"
+	if((magic & 0xff) == '<') {
+		infile.close();
+		return LoadTMX(fileName);
 	}
+	Release();
+	infile.clear();
+	infile.seekg(0);
 	std::string line;
 	while (std::getline(infile, line)) {
 		if(line == "[header]") {
 			if(!ReadHeader(infile)) {
-				assert(false); // invalid file data
+				std::cout << "Invalid header in " << fileName << "\n";
+				return false;
 			}
 		} else if(line == "[layer]") {
-			ReadLayerData(infile);
+			if(!ReadLayerData(infile)) {
+				std::cout << "Invalid layer in " << fileName << "\n";
+				return false;
+			}
 		} else if(line == "[ObjectsLayer]") {
 			ReadEntityData(infile);
 		}
 	}
+	if(tiles == nullptr) {
+		return false;
+	}
+	// the text export has no tile properties, nothing is solid
+	BakeCollision();
+	return true;
+}
+
+bool FlareMap::SaveBinary(const std::string &fileName) const {
+	std::ofstream outfile(fileName, std::ios::binary);
+	if(outfile.fail()) {
+		return false;
+	}
+	FlareMapFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = FLARE_MAP_MAGIC;
+	header.version = FLARE_MAP_VERSION;
+	header.width = mapWidth;
+	header.height = mapHeight;
+	header.entityCount = (uint32_t)entities.size();
+	header.tileOffset = sizeof(FlareMapFileHeader);
+	// keep the entity table 4-byte aligned after the 16-bit tiles
+	uint32_t tileBytes = mapWidth * mapHeight * sizeof(uint16_t);
+	header.entityOffset = header.tileOffset + ((tileBytes + 3) & ~3u);
+	header.propertyCount = (uint32_t)tileProperties.size();
+	header.propertyOffset = header.entityOffset + header.entityCount * sizeof(FlareMapFileEntity);
+	outfile.write((const char*)&header, sizeof(header));
+
+	outfile.write((const char*)tiles, tileBytes);
+	uint32_t zero = 0;
+	outfile.write((const char*)&zero, header.entityOffset - header.tileOffset - tileBytes);
+
+	for(size_t i=0; i < entities.size(); i++) {
+		FlareMapFileEntity entity;
+		memset(&entity, 0, sizeof(entity));
+		strncpy(entity.type, entities[i].type.c_str(), FLARE_MAP_TYPE_LENGTH - 1);
+		entity.x = entities[i].x;
+		entity.y = entities[i].y;
+		outfile.write((const char*)&entity, sizeof(entity));
+	}
+
+	for(size_t i=0; i < tileProperties.size(); i++) {
+		FlareMapFileTileProperties properties;
+		properties.flags = (tileProperties[i].solid ? FLARE_TILE_SOLID : 0) |
+			(tileProperties[i].oneWay ? FLARE_TILE_ONE_WAY : 0) |
+			(tileProperties[i].hazard ? FLARE_TILE_HAZARD : 0);
+		properties.friction = tileProperties[i].friction;
+		outfile.write((const char*)&properties, sizeof(properties));
+	}
+	return !outfile.fail();
+}
+
+bool FlareMap::LoadBinary(const std::string &fileName) {
+	Release();
+	mappedData = MapFile(fileName, mappedSize);
+	if(mappedData == nullptr) {
+		mappedSize = 0;
+		return false;
+	}
+
+	const FlareMapFileHeader *header = (const FlareMapFileHeader*)mappedData;
+	if(mappedSize < sizeof(FlareMapFileHeader) || header->magic != FLARE_MAP_MAGIC ||
+	   header->version != FLARE_MAP_VERSION ||
+	   header->tileOffset + (uint64_t)header->width * header->height * sizeof(uint16_t) > mappedSize ||
+	   header->entityOffset + (uint64_t)header->entityCount * sizeof(FlareMapFileEntity) > mappedSize ||
+	   header->propertyOffset + (uint64_t)header->propertyCount * sizeof(FlareMapFileTileProperties) > mappedSize) {
+		Release();
+		return false;
+	}
+	mapWidth = header->width;
+	mapHeight = header->height;
+	tiles = (const uint16_t*)((const char*)mappedData + header->tileOffset);
+
+	entities.clear();
+	const FlareMapFileEntity *fileEntities = (const FlareMapFileEntity*)((const char*)mappedData + header->entityOffset);
+	for(uint32_t i=0; i < header->entityCount; i++) {
+		FlareMapEntity newEntity;
+		newEntity.type = std::string(fileEntities[i].type, strnlen(fileEntities[i].type, FLARE_MAP_TYPE_LENGTH));
+		newEntity.x = fileEntities[i].x;
+		newEntity.y = fileEntities[i].y;
+		entities.push_back(newEntity);
+	}
+
+	const FlareMapFileTileProperties *fileProperties = (const FlareMapFileTileProperties*)((const char*)mappedData + header->propertyOffset);
+	tileProperties.resize(header->propertyCount);
+	for(uint32_t i=0; i < header->propertyCount; i++) {
+		tileProperties[i].solid = (fileProperties[i].flags & FLARE_TILE_SOLID) != 0;
+		tileProperties[i].oneWay = (fileProperties[i].flags & FLARE_TILE_ONE_WAY) != 0;
+		tileProperties[i].hazard = (fileProperties[i].flags & FLARE_TILE_HAZARD) != 0;
+		tileProperties[i].friction = fileProperties[i].friction;
+	}
+	BakeCollision();
+	return true;
+}
+
+void FlareMap::Release() {
+	if(mappedData != nullptr) {
+		UnmapFile(mappedData, mappedSize);
+		mappedData = nullptr;
+		mappedSize = 0;
+	}
+	std::vector<uint16_t>().swap(ownedTiles);
+	tiles = nullptr;
+	mapWidth = -1;
+	mapHeight = -1;
+	entities.clear();
+	tilesets.clear();
+	tileProperties.clear();
+	solid = FlareMapBitmap();
+	oneWay = FlareMapBitmap();
+	hazard = FlareMapBitmap();
+}
+
+void FlareMap::BakeCollision() {
+	solid.Reset(mapWidth, mapHeight);
+	oneWay.Reset(mapWidth, mapHeight);
+	hazard.Reset(mapWidth, mapHeight);
+	if(tileProperties.empty()) {
+		return;
+	}
+	for(int y=0; y < mapHeight; y++) {
+		FlareMapSpan row = Row(y);
+		for(int x=0; x < mapWidth; x++) {
+			if(row[x] >= tileProperties.size()) {
+				continue;
+			}
+			const FlareMapTileProperties &properties = tileProperties[row[x]];
+			if(properties.solid) { solid.Set(x, y); }
+			if(properties.oneWay) { oneWay.Set(x, y); }
+			if(properties.hazard) { hazard.Set(x, y); }
+		}
+	}
+}
+
+// directory part of path, including the trailing separator
+static std::string Directory(const std::string &path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+static bool ReadWholeFile(const std::string &fileName, std::string &contents) {
+	std::ifstream infile(fileName, std::ios::binary);
+	if(infile.fail()) {
+		return false;
+	}
+	infile.seekg(0, std::ios::end);
+	contents.resize((size_t)infile.tellg());
+	infile.seekg(0);
+	infile.read(&contents[0], contents.size());
+	return !infile.fail();
+}
+
+// points view at fileName inside pack, or reads the loose file into storage
+static bool OpenSource(const std::string &fileName, const AssetPack *pack, std::string &storage, AssetView &view) {
+	if(pack != nullptr && pack->Find(fileName, view)) {
+		return true;
+	}
+	if(!ReadWholeFile(fileName, storage)) {
+		return false;
+	}
+	view.data = (const unsigned char*)storage.data();
+	view.size = storage.size();
+	return true;
+}
+
+bool FlareMap::LoadTMX(const std::string &fileName, const AssetPack *pack) {
+	Release();
+	std::string contents;
+	AssetView mapSource;
+	if(!OpenSource(fileName, pack, contents, mapSource)) {
+		std::cout << "Unable to open map " << fileName << "\n";
+		return false;
+	}
+	int tileWidth = 0;
+	int tileHeight = 0;
+	XmlReader xml(mapSource.Chars(), mapSource.size);
+	while(true) {
+		XmlReader::Event event = xml.Next();
+		if(event == XmlReader::END_OF_DOCUMENT) {
+			break;
+		} else if(event == XmlReader::PARSE_ERROR) {
+			std::cout << "Malformed XML in " << fileName << "\n";
+			return false;
+		} else if(event != XmlReader::START_ELEMENT) {
+			continue;
+		}
+		if(xml.Name() == "map") {
+			if(xml.Attribute("orientation", "orthogonal") != "orthogonal" || xml.IntAttribute("infinite") != 0) {
+				std::cout << "Only finite orthogonal maps are supported\n";
+				return false;
+			}
+			mapWidth = xml.IntAttribute("width", -1);
+			mapHeight = xml.IntAttribute("height", -1);
+			tileWidth = xml.IntAttribute("tilewidth");
+			tileHeight = xml.IntAttribute("tileheight");
+			if(mapWidth <= 0 || mapHeight <= 0 || tileWidth <= 0 || tileHeight <= 0) {
+				return false;
+			}
+			ownedTiles.assign((size_t)mapWidth * mapHeight, 0);
+			tiles = ownedTiles.data();
+		} else if(xml.Name() == "tileset") {
+			FlareMapTileset tileset;
+			tileset.firstGid = xml.IntAttribute("firstgid", 1);
+			std::string source = xml.Attribute("source");
+			if(source.empty()) {
+				if(!ReadTMXTileset(xml, tileset)) {
+					return false;
+				}
+			} else {
+				xml.SkipElement();
+				// external tilesets are relative to the map
+				std::string tilesetContents;
+				AssetView tilesetSource;
+				if(!OpenSource(Directory(fileName) + source, pack, tilesetContents, tilesetSource)) {
+					std::cout << "Unable to open tileset " << source << "\n";
+					return false;
+				}
+				XmlReader tilesetXml(tilesetSource.Chars(), tilesetSource.size);
+				XmlReader::Event tilesetEvent;
+				while((tilesetEvent = tilesetXml.Next()) != XmlReader::START_ELEMENT) {
+					if(tilesetEvent == XmlReader::END_OF_DOCUMENT || tilesetEvent == XmlReader::PARSE_ERROR) {
+						return false;
+					}
+				}
+				if(tilesetXml.Name() != "tileset" || !ReadTMXTileset(tilesetXml, tileset)) {
+					return false;
+				}
+			}
+			tilesets.push_back(tileset);
+		} else if(xml.Name() == "layer") {
+			if(tiles == nullptr || !ReadTMXLayer(xml)) {
+				return false;
+			}
+		} else if(xml.Name() == "objectgroup") {
+			if(tiles == nullptr || !ReadTMXObjects(xml, tileWidth, tileHeight)) {
+				return false;
+			}
+		}
+	}
+	if(tiles == nullptr) {
+		return false;
+	}
+	for(size_t i=0; i < tilesets.size(); i++) {
+		const FlareMapTileset &tileset = tilesets[i];
+		size_t first = tileset.firstGid - 1;
+		if(tileProperties.size() < first + tileset.properties.size()) {
+			tileProperties.resize(first + tileset.properties.size());
+		}
+		std::copy(tileset.properties.begin(), tileset.properties.end(), tileProperties.begin() + first);
+	}
+	BakeCollision();
+	return true;
+}
+
+// reads the <tileset> element the reader just started, up to its end
+bool FlareMap::ReadTMXTileset(XmlReader &xml, FlareMapTileset &tileset) {
+	// gid 0 is an empty tile, so no tileset can start there
+	if(tileset.firstGid < 1) {
+		std::cout << "Tileset firstgid must be at least 1\n";
+		return false;
+	}
+	tileset.name = xml.Attribute("name");
+	tileset.tileWidth = xml.IntAttribute("tilewidth");
+	tileset.tileHeight = xml.IntAttribute("tileheight");
+	tileset.tileCount = xml.IntAttribute("tilecount");
+	tileset.columns = xml.IntAttribute("columns");
+	tileset.properties.assign(std::max(tileset.tileCount, 0), FlareMapTileProperties());
+	FlareMapTileProperties *tile = nullptr;
+	int depth = xml.Depth();
+	while(xml.Depth() >= depth) {
+		XmlReader::Event event = xml.Next();
+		if(event == XmlReader::END_OF_DOCUMENT || event == XmlReader::PARSE_ERROR) {
+			return false;
+		}
+		if(event == XmlReader::END_ELEMENT && xml.Name() == "tile") {
+			tile = nullptr;
+		}
+		if(event != XmlReader::START_ELEMENT) {
+			continue;
+		}
+		if(xml.Name() == "image") {
+			tileset.image = xml.Attribute("source");
+		} else if(xml.Name() == "tile") {
+			int id = xml.IntAttribute("id", -1);
+			tile = id >= 0 && id < (int)tileset.properties.size() ? &tileset.properties[id] : nullptr;
+		} else if(xml.Name() == "property" && tile != nullptr) {
+			std::string name = xml.Attribute("name");
+			std::string value = xml.Attribute("value");
+			if(name == "solid") {
+				tile->solid = value == "true";
+			} else if(name == "oneWay") {
+				tile->oneWay = value == "true";
+			} else if(name == "hazard") {
+				tile->hazard = value == "true";
+			} else if(name == "friction") {
+				tile->friction = (float)atof(value.c_str());
+			}
+		}
+	}
+	return tileset.tileWidth > 0 && tileset.tileHeight > 0;
+}
+
+// reads the <layer> element the reader just started, up to its end. Layer
+// data is base64 or csv encoded gids, or one <tile gid=""/> per tile.
+bool FlareMap::ReadTMXLayer(XmlReader &xml) {
+	if(xml.IntAttribute("width", mapWidth) != mapWidth || xml.IntAttribute("height", mapHeight) != mapHeight) {
+		std::cout << "Layers must be the size of the map\n";
+		return false;
+	}
+	size_t tileCount = (size_t)mapWidth * mapHeight;
+	size_t tileIndex = 0;
+	// gids no tileset has are left empty
+	auto covered = [&](uint32_t gid) {
+		for(const FlareMapTileset &tileset : tilesets) {
+			if(gid >= (uint32_t)tileset.firstGid && (tileset.tileCount <= 0 || gid < (uint32_t)tileset.firstGid + tileset.tileCount)) {
+				return true;
+			}
+		}
+		return false;
+	};
+	// store tiles the same way as the text export, gid - 1 with empty as 0
+	auto storeTile = [&](uint32_t gid) {
+		gid &= 0x1fffffff; // flip flags aren't supported, drop them
+		if(tileIndex >= tileCount || gid > 0x10000) { // tiles are stored in 16 bits
+			return false;
+		}
+		if(gid > 0 && !covered(gid)) {
+			gid = 0;
+		}
+		ownedTiles[tileIndex++] = gid > 0 ? gid-1 : 0;
+		return true;
+	};
+
+	std::string encoding;
+	int depth = xml.Depth();
+	while(xml.Depth() >= depth) {
+		XmlReader::Event event = xml.Next();
+		if(event == XmlReader::END_OF_DOCUMENT || event == XmlReader::PARSE_ERROR) {
+			return false;
+		}
+		if(event == XmlReader::START_ELEMENT && xml.Name() == "data") {
+			encoding = xml.Attribute("encoding");
+			if(xml.HasAttribute("compression")) {
+				std::cout << "Compressed layer data isn't supported, save the map uncompressed\n";
+				return false;
+			}
+		} else if(event == XmlReader::START_ELEMENT && xml.Name() == "tile") {
+			if(!storeTile(xml.IntAttribute("gid"))) {
+				return false;
+			}
+		} else if(event == XmlReader::TEXT && encoding == "base64") {
+			// decode a piece at a time into a small buffer, carrying over the
+			// bytes of a gid split between pieces
+			const size_t chunkLength = 4096;
+			unsigned char buffer[3 + chunkLength / 4 * 3 + 3];
+			size_t pending = 0;
+			Base64Decoder decoder;
+			for(size_t offset=0; offset < xml.TextLength(); offset += chunkLength) {
+				size_t length = std::min(chunkLength, xml.TextLength() - offset);
+				long decoded = decoder.Decode(xml.Text() + offset, length, buffer + pending);
+				if(decoded < 0) {
+					return false;
+				}
+				size_t filled = pending + decoded;
+				size_t i = 0;
+				for(; i + 4 <= filled; i += 4) {
+					uint32_t gid = buffer[i] | (buffer[i+1] << 8) | (buffer[i+2] << 16) | ((uint32_t)buffer[i+3] << 24);
+					if(!storeTile(gid)) {
+						return false;
+					}
+				}
+				pending = filled - i;
+				memmove(buffer, buffer + i, pending);
+			}
+			if(pending != 0 || !decoder.Finished()) {
+				return false;
+			}
+		} else if(event == XmlReader::TEXT && encoding == "csv") {
+			const char *position = xml.Text();
+			const char *end = position + xml.TextLength();
+			while(position < end) {
+				char *next;
+				unsigned long gid = strtoul(position, &next, 10);
+				if(next == position || !storeTile((uint32_t)gid)) {
+					return false;
+				}
+				position = next;
+				while(position < end && (*position == ',' || isspace((unsigned char)*position))) {
+					position++;
+				}
+			}
+		}
+	}
+	if(tileIndex != tileCount) {
+		std::cout << "Layer has " << tileIndex << " tiles, expected " << tileCount << "\n";
+		return false;
+	}
+	return true;
+}
+
+// reads the <objectgroup> element the reader just started, up to its end
+bool FlareMap::ReadTMXObjects(XmlReader &xml, int tileWidth, int tileHeight) {
+	int depth = xml.Depth();
+	while(xml.Depth() >= depth) {
+		XmlReader::Event event = xml.Next();
+		if(event == XmlReader::END_OF_DOCUMENT || event == XmlReader::PARSE_ERROR) {
+			return false;
+		}
+		if(event != XmlReader::START_ELEMENT || xml.Name() != "object") {
+			continue;
+		}
+		FlareMapEntity newEntity;
+		// newer versions of Tiled call the type "class"
+		newEntity.type = xml.Attribute("type", xml.Attribute("class", xml.Attribute("name")));
+		// in tiles, rounded the same way as the Flare export
+		newEntity.x = floorf(xml.FloatAttribute("x") / tileWidth);
+		newEntity.y = floorf(xml.FloatAttribute("y") / tileHeight);
+		entities.push_back(newEntity);
+	}
+	return true;
 }
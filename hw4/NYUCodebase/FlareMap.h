@@ -2,6 +2,10 @@
 
 #include <string>
 #include <vector>
+#include <stdint.h>
+
+class XmlReader;
+class AssetPack;
 
 struct FlareMapEntity {
 	std::string type;
@@ -9,22 +13,184 @@ struct FlareMapEntity {
 	float y;
 };
 
+// Custom properties set on a tile in the Tiled tileset editor:
+// solid (bool), oneWay (bool), hazard (bool) and friction (float).
+struct FlareMapTileProperties {
+	bool solid;
+	bool oneWay;
+	bool hazard;
+	// multiplier on ground friction
+	float friction;
+
+	FlareMapTileProperties() : solid(false), oneWay(false), hazard(false), friction(1.0f) {}
+};
+
+// A Tiled tileset referenced by a .tmx map. Tiles from it are stored as
+// gid - 1, so the first tileset's tile ids match the text export.
+struct FlareMapTileset {
+	int firstGid;
+	std::string name;
+	std::string image;
+	int tileWidth;
+	int tileHeight;
+	int tileCount;
+	int columns;
+	// indexed by the tile's id within the tileset
+	std::vector<FlareMapTileProperties> properties;
+};
+
+// One bit per map tile, row-major. Off the map reads as unset.
+struct FlareMapBitmap {
+	std::vector<uint32_t> bits;
+	int width;
+	int height;
+
+	FlareMapBitmap() : width(0), height(0) {}
+
+	void Reset(int mapWidth, int mapHeight) {
+		width = mapWidth;
+		height = mapHeight;
+		bits.assign(((size_t)width * height + 31) / 32, 0);
+	}
+	void Set(int x, int y) {
+		size_t i = (size_t)y * width + x;
+		bits[i >> 5] |= 1u << (i & 31);
+	}
+	bool Test(int x, int y) const {
+		if(x < 0 || y < 0 || x >= width || y >= height) {
+			return false;
+		}
+		size_t i = (size_t)y * width + x;
+		return (bits[i >> 5] >> (i & 31)) & 1;
+	}
+};
+
+// Compiled map file: a header, then mapWidth * mapHeight 16-bit tiles row by
+// row, then a table of fixed-size entity records, then the properties of each
+// tile id. The tiles are used straight out of the memory-mapped file.
+#define FLARE_MAP_MAGIC 0x50414d46 // "FMAP" little-endian
+#define FLARE_MAP_VERSION 2
+#define FLARE_MAP_TYPE_LENGTH 32
+
+#define FLARE_TILE_SOLID 1
+#define FLARE_TILE_ONE_WAY 2
+#define FLARE_TILE_HAZARD 4
+
+struct FlareMapFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t entityCount;
+	// byte offsets from the start of the file
+	uint32_t tileOffset;
+	uint32_t entityOffset;
+	uint32_t propertyCount;
+	uint32_t propertyOffset;
+};
+
+struct FlareMapFileTileProperties {
+	uint32_t flags;
+	float friction;
+};
+
+struct FlareMapFileEntity {
+	char type[FLARE_MAP_TYPE_LENGTH];
+	float x;
+	float y;
+};
+
+// A read-only run of tiles: a row (stride 1) or a column (stride mapWidth).
+struct FlareMapSpan {
+	const uint16_t *data;
+	int count;
+	int stride;
+
+	int size() const { return count; }
+	unsigned int operator[](int i) const { return data[i * stride]; }
+};
+
 class FlareMap {
 	public:
 		FlareMap();
 		~FlareMap();
+		FlareMap(FlareMap &&other);
+		FlareMap &operator=(FlareMap &&other);
+		FlareMap(const FlareMap&) = delete;
+		FlareMap &operator=(const FlareMap&) = delete;
 	
-		void Load(const std::string fileName);
+		// loads a Tiled .tmx map, the Tiled text export or a compiled map, by
+		// looking at the start of the file. false if it couldn't.
+		bool Load(const std::string fileName);
+		bool LoadBinary(const std::string &fileName);
+		// with a pack, fileName and any external tilesets are read out of it
+		// when it has them, and parsed in place
+		bool LoadTMX(const std::string &fileName, const AssetPack *pack = nullptr);
+		// compiles the loaded map
+		bool SaveBinary(const std::string &fileName) const;
+
+		// tiles are stored row-major in one buffer, either owned (text and .tmx maps) or
+		// inside the mapped file (compiled maps). GetTile doesn't check bounds.
+		unsigned int GetTile(int x, int y) const {
+			return tiles[y * mapWidth + x];
+		}
+		// returns outside for coordinates off the map
+		unsigned int GetTileChecked(int x, int y, unsigned int outside = 0) const {
+			if(x < 0 || y < 0 || x >= mapWidth || y >= mapHeight) {
+				return outside;
+			}
+			return tiles[y * mapWidth + x];
+		}
+		FlareMapSpan Row(int y) const {
+			FlareMapSpan span = {tiles + y * mapWidth, mapWidth, 1};
+			return span;
+		}
+		FlareMapSpan Column(int x) const {
+			FlareMapSpan span = {tiles + x, mapHeight, mapWidth};
+			return span;
+		}
+		const uint16_t *Data() const { return tiles; }
+
+		// properties of the tile at x, y; defaults for tiles no tileset describes
+		const FlareMapTileProperties &TileProperties(int x, int y) const {
+			unsigned int tile = GetTile(x, y);
+			return tile < tileProperties.size() ? tileProperties[tile] : defaultProperties;
+		}
+
+		// rebuilds solid, oneWay and hazard, call after changing tileProperties
+		void BakeCollision();
 
 		int mapWidth;
 		int mapHeight;
-		unsigned int **mapData;
 		std::vector<FlareMapEntity> entities;
+		// only filled in by LoadTMX
+		std::vector<FlareMapTileset> tilesets;
+		// indexed by stored tile id (gid - 1), from every tileset
+		std::vector<FlareMapTileProperties> tileProperties;
+		// baked from tileProperties when the map loads, so a collision check
+		// is a single bit test
+		FlareMapBitmap solid;
+		FlareMapBitmap oneWay;
+		FlareMapBitmap hazard;
 	
 	private:
 	
 		bool ReadHeader(std::ifstream &stream);
 		bool ReadLayerData(std::ifstream &stream);
 		bool ReadEntityData(std::ifstream &stream);
+		bool ReadTMXTileset(XmlReader &xml, FlareMapTileset &tileset);
+		bool ReadTMXLayer(XmlReader &xml);
+		bool ReadTMXObjects(XmlReader &xml, int tileWidth, int tileHeight);
+		void Release();
+		void MoveFrom(FlareMap &other);
+
+		FlareMapTileProperties defaultProperties;
+
+		const uint16_t *tiles;
+		// storage for text and .tmx maps
+		std::vector<uint16_t> ownedTiles;
+		// the compiled map file, if that's where tiles points
+		void *mappedData;
+		size_t mappedSize;
 	
 };
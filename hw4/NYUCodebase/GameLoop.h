@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+
+// Fixed-timestep main loop. Every frame it calls process once, update zero or
+// more times with exactly fixedTimestep, then render with alpha in [0, 1):
+// how far real time has got into the next, not yet simulated, step. Render
+// can use alpha to interpolate between the previous and current state.
+//
+// At most maxStepsPerFrame updates run per frame; any backlog beyond that is
+// dropped so a slow frame can't snowball into ever longer catch-up frames.
+// When the next step isn't due yet the loop sleeps (or yields, if it's due
+// very soon) instead of spinning.
+class GameLoop {
+	public:
+		GameLoop(float fixedTimestep, int maxStepsPerFrame = 5);
+
+		void Run(bool &done, const std::function<void()> &process,
+				 const std::function<void(float)> &update,
+				 const std::function<void(float)> &render);
+
+		void ResetStats();
+		void PrintStats() const;
+
+		float fixedTimestep;
+		int maxStepsPerFrame;
+		bool sleepWhenIdle;
+
+		// stats since the last ResetStats()
+		unsigned long frames;
+		unsigned long updates;
+		unsigned long cappedFrames;
+		double droppedSeconds;
+		double busySeconds;
+		double wallSeconds;
+		double maxFrameInterval;
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		static double Seconds(Clock::duration duration);
+		void RecordFrameInterval(double interval);
+
+		// running mean and sum of squared deviations of the frame interval (Welford)
+		double frameIntervalMean;
+		double frameIntervalM2;
+};
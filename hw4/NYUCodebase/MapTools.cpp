@@ -0,0 +1,642 @@
+#include "MapTools.h"
+#include "FlareMap.h"
+#include "TileCollider.h"
+#include "EntityPool.h"
+#include "TextureCache.h"
+#include "AssetPack.h"
+#include "stb_image.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+int ConvertMap(const std::string &inFile, const std::string &outFile) {
+    FlareMap map;
+    if (!map.Load(inFile)) {
+        std::cout << "Unable to load " << inFile << std::endl;
+        return 1;
+    }
+    if (!map.SaveBinary(outFile)) {
+        std::cout << "Unable to write " << outFile << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << outFile << ": " << map.mapWidth << "x" << map.mapHeight << " tiles, "
+              << map.entities.size() << " entities" << std::endl;
+    return 0;
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// sums every tile, so both paths actually touch all of the data
+static unsigned long long Checksum(const FlareMap &map) {
+    unsigned long long sum = 0;
+    for (int y = 0; y < map.mapHeight; y++) {
+        for (int x = 0; x < map.mapWidth; x++) {
+            sum += map.GetTile(x, y);
+        }
+    }
+    return sum;
+}
+
+// random map in the same layout as the Tiled export in tileMap.txt
+static void WriteBenchMap(const std::string &fileName, int width, int height) {
+    std::ofstream out(fileName.c_str());
+    out << "[header]\nwidth=" << width << "\nheight=" << height << "\ntilewidth=16\ntileheight=16\n\n";
+    out << "[layer]\ntype=Tile Layer 1\ndata=\n";
+    unsigned int seed = 1;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            seed = seed * 1103515245 + 12345;
+            out << ((seed >> 16) % 128) << (y + 1 < height || x + 1 < width ? "," : "");
+        }
+        out << "\n";
+    }
+    out << "\n[ObjectsLayer]\n# key\ntype=Item\nlocation=43,5,1,1\n\n";
+}
+
+// the same tiles as a Tiled map with base64 layer data
+static void WriteBenchTMX(const std::string &fileName, const FlareMap &map) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::vector<unsigned char> bytes;
+    bytes.reserve((size_t)map.mapWidth * map.mapHeight * 4);
+    for (int y = 0; y < map.mapHeight; y++) {
+        for (int x = 0; x < map.mapWidth; x++) {
+            unsigned int gid = map.GetTile(x, y) + 1;
+            bytes.push_back(gid & 0xff);
+            bytes.push_back((gid >> 8) & 0xff);
+            bytes.push_back((gid >> 16) & 0xff);
+            bytes.push_back(gid >> 24);
+        }
+    }
+    std::string encoded;
+    encoded.reserve(bytes.size() / 3 * 4 + 4);
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        unsigned int quad = bytes[i] << 16;
+        if (i + 1 < bytes.size()) quad |= bytes[i + 1] << 8;
+        if (i + 2 < bytes.size()) quad |= bytes[i + 2];
+        encoded += alphabet[(quad >> 18) & 63];
+        encoded += alphabet[(quad >> 12) & 63];
+        encoded += i + 1 < bytes.size() ? alphabet[(quad >> 6) & 63] : '=';
+        encoded += i + 2 < bytes.size() ? alphabet[quad & 63] : '=';
+    }
+    std::ofstream out(fileName.c_str());
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    out << "<map version=\"1.2\" orientation=\"orthogonal\" renderorder=\"right-down\" width=\"" << map.mapWidth
+        << "\" height=\"" << map.mapHeight << "\" tilewidth=\"16\" tileheight=\"16\" infinite=\"0\">\n";
+    // gids outside every tileset load as empty, so one has to cover the map's
+    out << " <tileset firstgid=\"1\" name=\"bench\" tilewidth=\"16\" tileheight=\"16\" tilecount=\"65536\" columns=\"256\"/>\n";
+    out << " <layer id=\"1\" name=\"Tile Layer 1\" width=\"" << map.mapWidth << "\" height=\"" << map.mapHeight << "\">\n";
+    out << "  <data encoding=\"base64\">\n   " << encoded << "\n  </data>\n </layer>\n</map>\n";
+}
+
+int BenchmarkMapLoad(long tileCount) {
+    const int width = 4000;
+    int height = (int)((tileCount + width - 1) / width);
+    std::string textFile = "bench_map.txt";
+    std::string binaryFile = "bench_map.flaremap";
+    std::string tmxFile = "bench_map.tmx";
+    WriteBenchMap(textFile, width, height);
+    std::cout << "Map: " << width << "x" << height << " (" << (long)width * height << " tiles)" << std::endl;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long long textSum;
+    {
+        FlareMap map;
+        if (!map.Load(textFile)) {
+            std::cout << "Unable to load " << textFile << std::endl;
+            return 1;
+        }
+        textSum = Checksum(map);
+        std::cout << "Text load: " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+        if (!map.SaveBinary(binaryFile)) {
+            std::cout << "Unable to write " << binaryFile << std::endl;
+            return 1;
+        }
+        WriteBenchTMX(tmxFile, map);
+    }
+
+    start = std::chrono::steady_clock::now();
+    unsigned long long tmxSum;
+    {
+        FlareMap map;
+        if (!map.Load(tmxFile)) {
+            std::cout << "Unable to load " << tmxFile << std::endl;
+            return 1;
+        }
+        tmxSum = Checksum(map);
+        std::cout << "TMX load: " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+    }
+
+    start = std::chrono::steady_clock::now();
+    unsigned long long binarySum;
+    {
+        FlareMap map;
+        if (!map.Load(binaryFile)) {
+            std::cout << "Unable to load " << binaryFile << std::endl;
+            return 1;
+        }
+        binarySum = Checksum(map);
+        std::cout << "Compiled load: " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+    }
+    if (textSum != binarySum || textSum != tmxSum) {
+        std::cout << "Checksum mismatch: " << textSum << " vs " << binarySum << " vs " << tmxSum << std::endl;
+        return 1;
+    }
+    remove(textFile.c_str());
+    remove(binaryFile.c_str());
+    remove(tmxFile.c_str());
+    return 0;
+}
+
+int BenchmarkTileLookup() {
+    const int width = 2000;
+    const int height = 2000;
+    const int probes = 10000000;
+    std::string textFile = "bench_tiles.txt";
+    WriteBenchMap(textFile, width, height);
+    FlareMap map;
+    bool loaded = map.Load(textFile);
+    remove(textFile.c_str());
+    if (!loaded) {
+        std::cout << "Unable to load " << textFile << std::endl;
+        return 1;
+    }
+
+    // the old layout: one allocation per row, reached through a row pointer
+    unsigned int **rows = new unsigned int*[height];
+    for (int y = 0; y < height; y++) {
+        rows[y] = new unsigned int[width];
+        for (int x = 0; x < width; x++) {
+            rows[y][x] = map.GetTile(x, y);
+        }
+    }
+    // probe coordinates are generated up front so only the lookups are timed
+    std::vector<int> probeX(probes);
+    std::vector<int> probeY(probes);
+    unsigned int seed = 7;
+    for (int i = 0; i < probes; i++) {
+        seed = seed * 1103515245 + 12345;
+        probeX[i] = (seed >> 8) % width;
+        seed = seed * 1103515245 + 12345;
+        probeY[i] = (seed >> 8) % height;
+    }
+
+    unsigned long long sums[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    double times[8];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < probes; i++) {
+        sums[0] += rows[probeY[i]][probeX[i]];
+    }
+    times[0] = SecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < probes; i++) {
+        sums[1] += map.GetTile(probeX[i], probeY[i]);
+    }
+    times[1] = SecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < probes; i++) {
+        sums[2] += map.GetTileChecked(probeX[i], probeY[i]);
+    }
+    times[2] = SecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            sums[3] += rows[y][x];
+        }
+    }
+    times[3] = SecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (int y = 0; y < height; y++) {
+        FlareMapSpan row = map.Row(y);
+        for (int x = 0; x < row.size(); x++) {
+            sums[4] += row[x];
+        }
+    }
+    times[4] = SecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (int x = 0; x < width; x++) {
+        FlareMapSpan column = map.Column(x);
+        for (int y = 0; y < column.size(); y++) {
+            sums[5] += column[y];
+        }
+    }
+    times[5] = SecondsSince(start);
+
+    // solidity: hw4's old id comparisons against the baked bitmap
+    const unsigned int solidIds[] = {3, 6, 17, 33};
+    for (unsigned int id : solidIds) {
+        if (map.tileProperties.size() <= id) {
+            map.tileProperties.resize(id + 1);
+        }
+        map.tileProperties[id].solid = true;
+    }
+    map.BakeCollision();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < probes; i++) {
+        unsigned int tile = map.GetTileChecked(probeX[i], probeY[i], (unsigned int)-1) + 1;
+        sums[6] += tile == 4 || tile == 7 || tile == 18 || tile == 34;
+    }
+    times[6] = SecondsSince(start);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < probes; i++) {
+        sums[7] += map.solid.Test(probeX[i], probeY[i]);
+    }
+    times[7] = SecondsSince(start);
+
+    for (int y = 0; y < height; y++) {
+        delete[] rows[y];
+    }
+    delete[] rows;
+
+    double tiles = (double)width * height;
+    std::cout << "Map: " << width << "x" << height << ", " << probes << " random probes" << std::endl;
+    std::cout << "Random, row pointers:   " << times[0] / probes * 1e9 << " ns/lookup" << std::endl;
+    std::cout << "Random, GetTile:        " << times[1] / probes * 1e9 << " ns/lookup" << std::endl;
+    std::cout << "Random, GetTileChecked: " << times[2] / probes * 1e9 << " ns/lookup" << std::endl;
+    std::cout << "Sweep, row pointers:    " << times[3] / tiles * 1e9 << " ns/tile" << std::endl;
+    std::cout << "Sweep, Row spans:       " << times[4] / tiles * 1e9 << " ns/tile" << std::endl;
+    std::cout << "Sweep, Column spans:    " << times[5] / tiles * 1e9 << " ns/tile" << std::endl;
+    std::cout << "Solid, id compares:     " << times[6] / probes * 1e9 << " ns/lookup" << std::endl;
+    std::cout << "Solid, bitmap:          " << times[7] / probes * 1e9 << " ns/lookup" << std::endl;
+    if (sums[0] != sums[1] || sums[1] != sums[2] || sums[3] != sums[4] || sums[4] != sums[5] || sums[6] != sums[7]) {
+        std::cout << "Checksum mismatch" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int BenchmarkCollision(int entityCount) {
+    const int width = 1000;
+    const int height = 1000;
+    const int steps = 600;
+    const float tileSize = 0.1f;
+    const float elapsed = 1.0f / 60.0f;
+    std::string textFile = "bench_collision.txt";
+    WriteBenchMap(textFile, width, height);
+    FlareMap map;
+    bool loaded = map.Load(textFile);
+    remove(textFile.c_str());
+    if (!loaded) {
+        std::cout << "Unable to load " << textFile << std::endl;
+        return 1;
+    }
+    // hw4's solid tiles, about 3% of the random map
+    const unsigned int solidIds[] = {3, 6, 17, 33};
+    for (unsigned int id : solidIds) {
+        if (map.tileProperties.size() <= id) {
+            map.tileProperties.resize(id + 1);
+        }
+        map.tileProperties[id].solid = true;
+    }
+    map.BakeCollision();
+    TileCollider collider(map, tileSize);
+
+    // entities the player's size, thrown around fast enough to cross several
+    // tiles a step, so a collider that only checks where they land would tunnel
+    std::vector<float> x(entityCount), y(entityCount), velocityX(entityCount), velocityY(entityCount);
+    unsigned int seed = 3;
+    auto random = [&seed](float range) {
+        seed = seed * 1103515245 + 12345;
+        return ((seed >> 8) & 0xffff) / 65535.0f * range;
+    };
+    for (int i = 0; i < entityCount; i++) {
+        // start in an empty tile
+        int tileX, tileY;
+        do {
+            tileX = 1 + (int)random(width - 2);
+            tileY = 1 + (int)random(height - 2);
+        } while (map.solid.Test(tileX, tileY));
+        x[i] = (tileX + 0.5f) * tileSize;
+        y[i] = -(tileY + 0.5f) * tileSize;
+        velocityX[i] = random(24.0f) - 12.0f;
+        velocityY[i] = random(24.0f) - 12.0f;
+    }
+
+    long contacts = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        for (int i = 0; i < entityCount; i++) {
+            velocityY[i] -= 7.0f * elapsed;
+            TileMove move = collider.Move(x[i], y[i], 0.08f, 0.08f, velocityX[i] * elapsed, velocityY[i] * elapsed);
+            x[i] = move.x;
+            y[i] = move.y;
+            for (int c = 0; c < move.contactCount; c++) {
+                // bounce, to keep everything moving
+                if (move.contacts[c].normalX != 0) {
+                    velocityX[i] = -velocityX[i];
+                } else {
+                    velocityY[i] = -velocityY[i];
+                }
+            }
+            contacts += move.contactCount;
+        }
+    }
+    double seconds = SecondsSince(start);
+
+    // nothing may end up inside a solid tile
+    int inside = 0;
+    for (int i = 0; i < entityCount; i++) {
+        int minX = (int)floorf(x[i] / tileSize - 0.4f + 0.001f);
+        int maxX = (int)floorf(x[i] / tileSize + 0.4f - 0.001f);
+        int minY = (int)floorf(-y[i] / tileSize - 0.4f + 0.001f);
+        int maxY = (int)floorf(-y[i] / tileSize + 0.4f - 0.001f);
+        bool overlaps = false;
+        for (int tileY = minY; tileY <= maxY; tileY++) {
+            for (int tileX = minX; tileX <= maxX; tileX++) {
+                overlaps = overlaps || map.solid.Test(tileX, tileY);
+            }
+        }
+        inside += overlaps;
+    }
+
+    double entitySteps = (double)entityCount * steps;
+    std::cout << "Map: " << width << "x" << height << ", " << entityCount << " entities, " << steps << " steps" << std::endl;
+    std::cout << "Swept moves: " << entitySteps / seconds / 1e6 << "M entity-steps/s ("
+              << seconds / entitySteps * 1e9 << " ns each), " << contacts << " contacts" << std::endl;
+    std::cout << "At 60 Hz that's about " << (long)(entitySteps / seconds / 60) << " entities per frame on one core" << std::endl;
+    if (inside != 0) {
+        std::cout << inside << " entities ended up inside solid tiles" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// floors of solid tiles every 8 rows, with walls two tiles high here and there
+static void WriteWalkMap(const std::string &fileName, int width, int height) {
+    std::ofstream out(fileName.c_str());
+    out << "[header]\nwidth=" << width << "\nheight=" << height << "\ntilewidth=16\ntileheight=16\n\n";
+    out << "[layer]\ntype=Tile Layer 1\ndata=\n";
+    unsigned int seed = 5;
+    std::vector<bool> wall(width);
+    for (int x = 0; x < width; x++) {
+        seed = seed * 1103515245 + 12345;
+        wall[x] = x == 0 || x == width - 1 || (seed >> 16) % 40 == 0;
+    }
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            // Tiled id 4 is tile 3, one of hw4's solid tiles
+            bool solid = y % 8 == 7 || (wall[x] && y % 8 >= 5);
+            out << (solid ? 4 : 0) << (y + 1 < height || x + 1 < width ? "," : "");
+        }
+        out << "\n";
+    }
+}
+
+// what the same entities cost as Entity objects, laid out like hw4's Entity
+struct BenchEntity {
+    float position[3];
+    float previousPosition[3];
+    float spawnPosition[3];
+    float velocity[3];
+    float acceleration[3];
+    float size[3];
+    unsigned int sprite[4];
+    bool collidedTop;
+    bool collidedBottom;
+    bool collidedLeft;
+    bool collidedRight;
+    float groundFriction;
+    bool touchedHazard;
+};
+
+int BenchmarkEntities(int entityCount) {
+    const int width = 1024;
+    const int height = 256;
+    const int steps = 600;
+    const float tileSize = 0.1f;
+    const float elapsed = 1.0f / 60.0f;
+    const float gravityY = -7.0f;
+    const float frictionX = 7.0f;
+    std::string textFile = "bench_entities.txt";
+    WriteWalkMap(textFile, width, height);
+    FlareMap map;
+    bool loaded = map.Load(textFile);
+    remove(textFile.c_str());
+    if (!loaded) {
+        std::cout << "Unable to load " << textFile << std::endl;
+        return 1;
+    }
+    FlareMapTileProperties solid;
+    solid.solid = true;
+    map.tileProperties.assign(4, FlareMapTileProperties());
+    map.tileProperties[3] = solid;
+    map.BakeCollision();
+    TileCollider collider(map, tileSize);
+
+    // dino-sized walkers standing on random floors, half heading each way
+    EntityPool pool;
+    pool.Reserve(entityCount);
+    std::vector<BenchEntity> objects(entityCount);
+    unsigned int seed = 9;
+    for (int i = 0; i < entityCount; i++) {
+        int tileX;
+        do {
+            seed = seed * 1103515245 + 12345;
+            tileX = 1 + (seed >> 8) % (width - 3);
+        } while (map.solid.Test(tileX, 6) || map.solid.Test(tileX + 1, 6));
+        seed = seed * 1103515245 + 12345;
+        int floor = (seed >> 8) % (height / 8);
+        float x = (tileX + 1) * tileSize;
+        float y = -(floor * 8 + 6) * tileSize;
+        int index = pool.Add(x, y, 0.2f, 0.2f);
+        pool.accelerationX[index] = i % 2 ? 4.0f : -4.0f;
+
+        BenchEntity &entity = objects[i];
+        memset(&entity, 0, sizeof(entity));
+        entity.position[0] = entity.previousPosition[0] = entity.spawnPosition[0] = x;
+        entity.position[1] = entity.previousPosition[1] = entity.spawnPosition[1] = y;
+        entity.size[0] = entity.size[1] = 0.2f;
+        entity.size[2] = 1.0f;
+        entity.acceleration[0] = pool.accelerationX[index];
+        entity.groundFriction = 1.0f;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        for (BenchEntity &entity : objects) {
+            for (int axis = 0; axis < 3; axis++) {
+                entity.previousPosition[axis] = entity.position[axis];
+            }
+            if (entity.collidedBottom) {
+                entity.velocity[0] *= 1.0f - elapsed * frictionX * entity.groundFriction;
+            }
+            entity.velocity[1] += gravityY * elapsed;
+            entity.velocity[0] += entity.acceleration[0] * elapsed;
+            entity.velocity[1] += entity.acceleration[1] * elapsed;
+            TileMove move = collider.Move(entity.position[0], entity.position[1], entity.size[0], entity.size[1],
+                                          entity.velocity[0] * elapsed, entity.velocity[1] * elapsed);
+            entity.position[0] = move.x;
+            entity.position[1] = move.y;
+            for (int c = 0; c < move.contactCount; c++) {
+                const TileContact &contact = move.contacts[c];
+                if (contact.normalX != 0) {
+                    entity.velocity[0] = 0;
+                } else {
+                    entity.velocity[1] = 0;
+                }
+                if (contact.normalY > 0) {
+                    entity.groundFriction = map.TileProperties(contact.tileX, contact.tileY).friction;
+                }
+            }
+            int gridX = (int)(entity.position[0] / tileSize);
+            entity.touchedHazard = map.hazard.Test(gridX, (int)(entity.position[1] / -tileSize)) ||
+                map.hazard.Test(gridX, (int)((entity.position[1] - entity.size[1] / 2) / -tileSize));
+            entity.collidedTop = move.collidedTop;
+            entity.collidedBottom = move.collidedBottom;
+            entity.collidedLeft = move.collidedLeft;
+            entity.collidedRight = move.collidedRight;
+            if (entity.collidedLeft || entity.collidedRight) {
+                entity.acceleration[0] = -entity.acceleration[0];
+            }
+        }
+    }
+    double objectSeconds = SecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        pool.Update(elapsed, collider, gravityY, frictionX, 0.0f);
+        // walk the other way on hitting a wall
+        for (int i = 0; i < pool.Count(); i++) {
+            if (pool.flags[i] & (ENTITY_COLLIDED_LEFT | ENTITY_COLLIDED_RIGHT)) {
+                pool.accelerationX[i] = -pool.accelerationX[i];
+            }
+        }
+    }
+    double poolSeconds = SecondsSince(start);
+
+    // both versions must have walked everyone to the same place
+    int mismatched = 0;
+    for (int i = 0; i < entityCount; i++) {
+        if (fabsf(pool.x[i] - objects[i].position[0]) > 0.001f || fabsf(pool.y[i] - objects[i].position[1]) > 0.001f) {
+            mismatched++;
+        }
+    }
+
+    double entitySteps = (double)entityCount * steps;
+    std::cout << "Map: " << width << "x" << height << ", " << entityCount << " walkers, " << steps << " steps" << std::endl;
+    std::cout << "Entity objects: " << entitySteps / objectSeconds / 1e6 << "M entity-steps/s, "
+              << objectSeconds / steps * 1000.0 << " ms/step" << std::endl;
+    std::cout << "Entity pool:    " << entitySteps / poolSeconds / 1e6 << "M entity-steps/s, "
+              << poolSeconds / steps * 1000.0 << " ms/step" << std::endl;
+    std::cout << "At 60 Hz the pool fits about " << (long)(entitySteps / poolSeconds / 60) << " walkers per frame on one core" << std::endl;
+    if (mismatched != 0) {
+        std::cout << mismatched << " entities ended up in different places" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static unsigned long long Checksum(const unsigned char *data, size_t size) {
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum = sum * 31 + data[i];
+    }
+    return sum;
+}
+
+int BenchmarkTextureCache(const std::string &image, int loadCount) {
+    // the blob goes in the working directory, like the other bench files
+    TextureCache cache("");
+    TextureCacheKey key;
+    if (!TextureCache::MakeKey(image, key)) {
+        std::cout << "Unable to read " << image << std::endl;
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long long decodeSum = 0;
+    int width = 0, height = 0;
+    for (int i = 0; i < loadCount; i++) {
+        int comp;
+        unsigned char *pixels = stbi_load(image.c_str(), &width, &height, &comp, STBI_rgb_alpha);
+        if (pixels == NULL) {
+            std::cout << "Unable to decode " << image << std::endl;
+            return 1;
+        }
+        decodeSum = Checksum(pixels, (size_t)width * height * 4);
+        if (i == 0) {
+            cache.Store(key, pixels, width, height);
+        }
+        stbi_image_free(pixels);
+    }
+    std::cout << "Image: " << width << "x" << height << ", " << loadCount << " loads" << std::endl;
+    std::cout << "PNG decode: " << SecondsSince(start) * 1000.0 / loadCount << " ms per load" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    unsigned long long cacheSum = 0;
+    for (int i = 0; i < loadCount; i++) {
+        TextureCacheKey warmKey;
+        TextureBlob blob;
+        if (!TextureCache::MakeKey(image, warmKey) || !cache.Find(warmKey, blob)) {
+            std::cout << "Texture cache miss" << std::endl;
+            return 1;
+        }
+        cacheSum = Checksum(blob.pixels, (size_t)blob.width * blob.height * 4);
+        TextureCache::Release(blob);
+    }
+    std::cout << "Cache hit: " << SecondsSince(start) * 1000.0 / loadCount << " ms per load" << std::endl;
+
+    if (decodeSum != cacheSum) {
+        std::cout << "Checksum mismatch: " << decodeSum << " vs " << cacheSum << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int BenchmarkAssetPack(const std::string &folder, const std::vector<std::string> &names, int roundCount) {
+    std::string packFile = "bench_assets.pack";
+    if (!AssetPack::Write(packFile, folder, names)) {
+        return 1;
+    }
+    std::cout << names.size() << " files, " << roundCount << " rounds" << std::endl;
+
+    // what a start from loose files does: open and read every one
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned long long looseSum = 0;
+    std::vector<unsigned char> contents;
+    for (int round = 0; round < roundCount; round++) {
+        looseSum = 0;
+        for (const std::string &name : names) {
+            std::ifstream infile(folder + name, std::ios::binary);
+            infile.seekg(0, std::ios::end);
+            contents.resize((size_t)infile.tellg());
+            infile.seekg(0);
+            infile.read((char*)contents.data(), contents.size());
+            looseSum += Checksum(contents.data(), contents.size());
+        }
+    }
+    std::cout << "Loose files: " << SecondsSince(start) * 1000.0 / roundCount << " ms per round" << std::endl;
+
+    // and from the pack: map it once, then look each one up
+    start = std::chrono::steady_clock::now();
+    unsigned long long packSum = 0;
+    for (int round = 0; round < roundCount; round++) {
+        packSum = 0;
+        AssetPack pack;
+        if (!pack.Open(packFile)) {
+            return 1;
+        }
+        for (const std::string &name : names) {
+            AssetView view;
+            if (!pack.Find(name, view)) {
+                std::cout << name << " missing from the pack" << std::endl;
+                return 1;
+            }
+            packSum += Checksum(view.data, view.size);
+        }
+    }
+    std::cout << "Asset pack: " << SecondsSince(start) * 1000.0 / roundCount << " ms per round" << std::endl;
+
+    remove(packFile.c_str());
+    if (looseSum != packSum) {
+        std::cout << "Checksum mismatch: " << looseSum << " vs " << packSum << std::endl;
+        return 1;
+    }
+    return 0;
+}
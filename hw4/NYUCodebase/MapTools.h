@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Command line map tools, run instead of the game:
+//   --convert-map <in> <out.flaremap>       compile a .tmx or Tiled text export
+//   --bench-map [tiles]                     time text vs compiled vs .tmx loading
+//   --bench-tiles                           time tile and solidity lookups
+//   --bench-collision [entities]            time swept moves through the tiles
+//   --bench-entities [entities]             time walking entities, objects vs EntityPool
+//   --bench-textures [loads]                time PNG decoding vs the texture cache
+//   --pack <out.pack> <folder/> <files...>  build an asset pack
+//   --bench-pack [rounds]                   time reading the game's files loose vs from a pack
+int ConvertMap(const std::string &inFile, const std::string &outFile);
+int BenchmarkMapLoad(long tileCount);
+int BenchmarkTileLookup();
+int BenchmarkCollision(int entityCount);
+int BenchmarkEntities(int entityCount);
+int BenchmarkTextureCache(const std::string &image, int loadCount);
+int BenchmarkAssetPack(const std::string &folder, const std::vector<std::string> &names, int roundCount);
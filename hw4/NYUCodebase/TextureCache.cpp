@@ -0,0 +1,137 @@
+#include "TextureCache.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WINDOWS
+#include <windows.h>
+#endif
+
+// "TXC1"
+#define TEXTURE_CACHE_MAGIC 0x31435854
+
+struct TextureCacheHeader {
+    uint32_t magic;
+    uint32_t pathLength;
+    int64_t modified;
+    uint64_t size;
+    uint64_t hash;
+    int32_t width;
+    int32_t height;
+};
+
+// the path follows the header, then the pixels at the next 16 byte boundary
+static size_t PixelOffset(size_t pathLength) {
+    return (sizeof(TextureCacheHeader) + pathLength + 15) & ~(size_t)15;
+}
+
+TextureCache::TextureCache(const std::string &directory) : directory(directory) {}
+
+std::string TextureCache::BlobPath(const std::string &path) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.rgba",
+             (unsigned long long)Fnv1a(path.data(), path.size()));
+    return directory + name;
+}
+
+bool TextureCache::MakeKey(const std::string &path, TextureCacheKey &key) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    key.path = path;
+    key.modified = (int64_t)info.st_mtime;
+    key.size = 0;
+    key.hash = FNV1A_SEED;
+    unsigned char buffer[16384];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        key.hash = Fnv1a(buffer, count, key.hash);
+        key.size += count;
+    }
+    fclose(file);
+    return true;
+}
+
+void TextureCache::MakeKey(const std::string &path, const unsigned char *data, size_t size, TextureCacheKey &key) {
+    key.path = path;
+    // the content hash already tells versions apart
+    key.modified = 0;
+    key.size = size;
+    key.hash = Fnv1a(data, size);
+}
+
+bool TextureCache::Find(const TextureCacheKey &key, TextureBlob &blob) {
+    size_t size = 0;
+    void *view = MapFile(BlobPath(key.path), size);
+    if (view == NULL) {
+        return false;
+    }
+    const unsigned char *bytes = (const unsigned char *)view;
+    TextureCacheHeader header;
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        memcpy(&header, bytes, sizeof(header));
+        size_t offset = PixelOffset(header.pathLength);
+        valid = header.magic == TEXTURE_CACHE_MAGIC && header.modified == key.modified &&
+                header.size == key.size && header.hash == key.hash &&
+                header.pathLength == key.path.size() && header.width > 0 && header.height > 0 &&
+                size == offset + (size_t)header.width * header.height * 4 &&
+                memcmp(bytes + sizeof(header), key.path.data(), key.path.size()) == 0;
+    }
+    if (!valid) {
+        UnmapFile(view, size);
+        return false;
+    }
+    blob.pixels = bytes + PixelOffset(header.pathLength);
+    blob.width = header.width;
+    blob.height = header.height;
+    blob.mapping = view;
+    blob.mappingSize = size;
+    return true;
+}
+
+bool TextureCache::Store(const TextureCacheKey &key, const unsigned char *pixels, int width, int height) {
+    static std::atomic<unsigned int> writes(0);
+    std::string blobPath = BlobPath(key.path);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%u.tmp", writes++);
+    std::string temporaryPath = blobPath + suffix;
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+    if (file == NULL) {
+        return false;
+    }
+    TextureCacheHeader header = {TEXTURE_CACHE_MAGIC, (uint32_t)key.path.size(), key.modified,
+                                 key.size, key.hash, width, height};
+    static const char padding[16] = {0};
+    size_t paddingLength = PixelOffset(key.path.size()) - sizeof(header) - key.path.size();
+    size_t pixelBytes = (size_t)width * height * 4;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(key.path.data(), 1, key.path.size(), file) == key.path.size() &&
+              fwrite(padding, 1, paddingLength, file) == paddingLength &&
+              fwrite(pixels, 1, pixelBytes, file) == pixelBytes;
+    ok = fclose(file) == 0 && ok;
+#ifdef _WINDOWS
+    ok = ok && MoveFileExA(temporaryPath.c_str(), blobPath.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(temporaryPath.c_str(), blobPath.c_str()) == 0;
+#endif
+    if (!ok) {
+        remove(temporaryPath.c_str());
+    }
+    return ok;
+}
+
+void TextureCache::Release(TextureBlob &blob) {
+    if (blob.mapping != NULL) {
+        UnmapFile(blob.mapping, blob.mappingSize);
+    }
+    blob = TextureBlob();
+}
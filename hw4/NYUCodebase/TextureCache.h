@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// identifies one version of a source image
+struct TextureCacheKey {
+	std::string path;
+	int64_t modified;
+	uint64_t size;
+	// FNV-1a of the file's bytes
+	uint64_t hash;
+};
+
+// a cached image, mapped read-only into memory until Release
+struct TextureBlob {
+	TextureBlob() : pixels(0), width(0), height(0), mapping(0), mappingSize(0) {}
+
+	const unsigned char *pixels;
+	int width;
+	int height;
+	void *mapping;
+	size_t mappingSize;
+};
+
+// Decoded RGBA images kept on disk, so a warm start maps the pixels straight
+// out of the cache instead of inflating the PNG again. Each source path gets
+// one blob, named after a hash of the path, whose header records the path,
+// modification time, size and content hash of the file it was decoded from;
+// a blob only counts if all four still match. Blobs are written to a
+// temporary name and renamed into place, so a reader never sees half of one.
+class TextureCache {
+	public:
+		// directory must exist and end in a path separator
+		TextureCache(const std::string &directory);
+
+		// false if the source file can't be read
+		static bool MakeKey(const std::string &path, TextureCacheKey &key);
+		// for a file that's already in memory, like an asset pack entry
+		static void MakeKey(const std::string &path, const unsigned char *data, size_t size, TextureCacheKey &key);
+		// maps the cached pixels for key, false on a miss
+		bool Find(const TextureCacheKey &key, TextureBlob &blob);
+		bool Store(const TextureCacheKey &key, const unsigned char *pixels, int width, int height);
+		static void Release(TextureBlob &blob);
+
+		std::string directory;
+
+	private:
+		std::string BlobPath(const std::string &path) const;
+};
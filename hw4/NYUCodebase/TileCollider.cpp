@@ -0,0 +1,156 @@
+#include "TileCollider.h"
+#include <cmath>
+
+// boxes flush against a tile edge aren't overlapping it; positions within
+// this many tiles of an edge count as on it
+#define TILE_EPSILON 0.0001f
+
+TileCollider::TileCollider(const FlareMap &map, float tileSize) : map(&map), tileSize(tileSize) {}
+
+// first and last tile a span from min to max overlaps, ignoring edges it just touches
+static void TileSpan(float min, float max, int &first, int &last) {
+    first = (int)floorf(min + TILE_EPSILON);
+    last = (int)ceilf(max - TILE_EPSILON) - 1;
+}
+
+int TileCollider::BlockingRow(int column, int minRow, int maxRow) const {
+    for (int row = minRow; row <= maxRow; row++) {
+        if (map->solid.Test(column, row)) {
+            return row;
+        }
+    }
+    return -1;
+}
+
+int TileCollider::BlockingColumn(int row, int minColumn, int maxColumn, bool down) const {
+    for (int column = minColumn; column <= maxColumn; column++) {
+        if (map->solid.Test(column, row) || (down && map->oneWay.Test(column, row))) {
+            return column;
+        }
+    }
+    return -1;
+}
+
+bool TileCollider::SweepTiles(float minX, float minY, float maxX, float maxY, float dx, float dy, TileContact &contact) const {
+    // the next boundary each leading edge crosses, the tile behind it, and when
+    int stepX = dx > 0 ? 1 : -1;
+    int stepY = dy > 0 ? 1 : -1;
+    int column = 0;
+    int row = 0;
+    float nextX = INFINITY;
+    float nextY = INFINITY;
+    float deltaX = INFINITY;
+    float deltaY = INFINITY;
+    if (dx != 0) {
+        float boundary = dx > 0 ? ceilf(maxX - TILE_EPSILON) : floorf(minX + TILE_EPSILON);
+        column = dx > 0 ? (int)boundary : (int)boundary - 1;
+        nextX = (boundary - (dx > 0 ? maxX : minX)) / dx;
+        deltaX = 1.0f / fabsf(dx);
+    }
+    if (dy != 0) {
+        float boundary = dy > 0 ? ceilf(maxY - TILE_EPSILON) : floorf(minY + TILE_EPSILON);
+        row = dy > 0 ? (int)boundary : (int)boundary - 1;
+        nextY = (boundary - (dy > 0 ? maxY : minY)) / dy;
+        deltaY = 1.0f / fabsf(dy);
+    }
+
+    while (nextX <= 1.0f || nextY <= 1.0f) {
+        if (nextX <= nextY) {
+            float t = fmaxf(nextX, 0.0f);
+            int firstRow, lastRow;
+            TileSpan(minY + dy * t, maxY + dy * t, firstRow, lastRow);
+            // crossing a corner exactly, also check the tile diagonally ahead
+            if (nextY - nextX < TILE_EPSILON * deltaY) {
+                firstRow = stepY < 0 ? row : firstRow;
+                lastRow = stepY > 0 ? row : lastRow;
+            }
+            int hitRow = BlockingRow(column, firstRow, lastRow);
+            if (hitRow >= 0) {
+                contact.time = t;
+                contact.normalX = (float)-stepX;
+                contact.normalY = 0;
+                contact.tileX = column;
+                contact.tileY = hitRow;
+                return true;
+            }
+            column += stepX;
+            nextX += deltaX;
+        } else {
+            float t = fmaxf(nextY, 0.0f);
+            int firstColumn, lastColumn;
+            TileSpan(minX + dx * t, maxX + dx * t, firstColumn, lastColumn);
+            int hitColumn = BlockingColumn(row, firstColumn, lastColumn, dy > 0);
+            if (hitColumn >= 0) {
+                contact.time = t;
+                contact.normalX = 0;
+                // tile space y points down, world space up
+                contact.normalY = (float)stepY;
+                contact.tileX = hitColumn;
+                contact.tileY = row;
+                return true;
+            }
+            row += stepY;
+            nextY += deltaY;
+        }
+    }
+    return false;
+}
+
+bool TileCollider::Sweep(float x, float y, float width, float height, float dx, float dy, TileContact &contact) const {
+    float scale = 1.0f / tileSize;
+    float tileX = x * scale;
+    float tileY = -y * scale;
+    float halfWidth = width * scale / 2;
+    float halfHeight = height * scale / 2;
+    return SweepTiles(tileX - halfWidth, tileY - halfHeight, tileX + halfWidth, tileY + halfHeight,
+                      dx * scale, -dy * scale, contact);
+}
+
+TileMove TileCollider::Move(float x, float y, float width, float height, float dx, float dy) const {
+    float scale = 1.0f / tileSize;
+    TileMove move = MoveTiles(x * scale, -y * scale, width * scale / 2, height * scale / 2, dx * scale, -dy * scale);
+    move.x *= tileSize;
+    move.y *= -tileSize;
+    return move;
+}
+
+TileMove TileCollider::MoveTiles(float centerX, float centerY, float halfWidth, float halfHeight, float dx, float dy) const {
+    TileMove move = {};
+    float remainingX = dx;
+    float remainingY = dy;
+    float elapsed = 0;
+    while (remainingX != 0 || remainingY != 0) {
+        TileContact contact;
+        if (move.contactCount == TILE_MAX_CONTACTS ||
+            !SweepTiles(centerX - halfWidth, centerY - halfHeight, centerX + halfWidth, centerY + halfHeight,
+                        remainingX, remainingY, contact)) {
+            if (move.contactCount < TILE_MAX_CONTACTS) {
+                centerX += remainingX;
+                centerY += remainingY;
+            }
+            break;
+        }
+        // move up to the contact, snapping flush against the tile that was hit
+        centerX += remainingX * contact.time;
+        centerY += remainingY * contact.time;
+        if (contact.normalX != 0) {
+            centerX = contact.normalX < 0 ? contact.tileX - halfWidth : contact.tileX + 1 + halfWidth;
+            remainingX = 0;
+            remainingY *= 1.0f - contact.time;
+            move.collidedRight |= contact.normalX < 0;
+            move.collidedLeft |= contact.normalX > 0;
+        } else {
+            centerY = contact.normalY < 0 ? contact.tileY + 1 + halfHeight : contact.tileY - halfHeight;
+            remainingY = 0;
+            remainingX *= 1.0f - contact.time;
+            move.collidedBottom |= contact.normalY > 0;
+            move.collidedTop |= contact.normalY < 0;
+        }
+        elapsed += (1.0f - elapsed) * contact.time;
+        contact.time = elapsed;
+        move.contacts[move.contactCount++] = contact;
+    }
+    move.x = centerX;
+    move.y = centerY;
+    return move;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "FlareMap.h"
+
+// A solid tile a moving box ran into.
+struct TileContact {
+	// fraction of the whole step's motion covered before touching, 0 to 1
+	float time;
+	// surface normal in world space, e.g. (0, 1) when landing on a floor
+	float normalX;
+	float normalY;
+	int tileX;
+	int tileY;
+};
+
+// max contacts per move: one per axis, and a retry after sliding into a corner
+#define TILE_MAX_CONTACTS 3
+
+struct TileMove {
+	// where the box's centre ended up
+	float x;
+	float y;
+	int contactCount;
+	TileContact contacts[TILE_MAX_CONTACTS];
+	bool collidedTop;
+	bool collidedBottom;
+	bool collidedLeft;
+	bool collidedRight;
+};
+
+// Swept box collision against a FlareMap's solid bitmap. Tile x, y covers
+// world x in [x, x + 1) * tileSize and world y in (-(y + 1), -y] * tileSize.
+// The sweep walks the grid DDA-style: it steps from one tile boundary the
+// box's leading edges cross to the next, in the order they're crossed along
+// the motion vector, and checks every tile the box overlaps on entering a new
+// row or column. Nothing tunnels however far a box moves in one step. Boxes
+// only collide with tiles they move into, and one-way tiles only stop boxes
+// moving down onto them. Off the map is empty.
+class TileCollider {
+	public:
+		TileCollider(const FlareMap &map, float tileSize);
+
+		// earliest contact moving a box centred at x, y by dx, dy, all in world
+		// units; false if it gets there without touching anything
+		bool Sweep(float x, float y, float width, float height, float dx, float dy, TileContact &contact) const;
+		// moves the box by dx, dy, sliding along whatever it hits. Callers zero
+		// their velocity along the normals of the contacts.
+		TileMove Move(float x, float y, float width, float height, float dx, float dy) const;
+		// Move in tile units with y pointing down, for callers that keep their
+		// boxes in tile space. The result's x, y are in tile units too.
+		TileMove MoveTiles(float centerX, float centerY, float halfWidth, float halfHeight, float dx, float dy) const;
+
+		const FlareMap *map;
+		float tileSize;
+
+	private:
+		// the sweep itself, in tile units with y pointing down
+		bool SweepTiles(float minX, float minY, float maxX, float maxY, float dx, float dy, TileContact &contact) const;
+		// first solid tile in the span, or -1
+		int BlockingRow(int column, int minRow, int maxRow) const;
+		int BlockingColumn(int row, int minColumn, int maxColumn, bool down) const;
+};
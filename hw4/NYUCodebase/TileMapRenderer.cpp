@@ -0,0 +1,99 @@
+#include "TileMapRenderer.h"
+#include <cmath>
+
+TileMapRenderer::TileMapRenderer() : chunksDrawn(0), vertexBuffer(0), chunksX(0), chunksY(0), chunkWorldSize(0) {}
+
+void TileMapRenderer::Build(const FlareMap &map, float tileSize, int spriteCountX, int spriteCountY) {
+    chunksX = (map.mapWidth + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    chunksY = (map.mapHeight + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+    chunkWorldSize = tileSize * TILE_CHUNK_SIZE;
+    chunks.assign(chunksX * chunksY, Chunk());
+    
+    float spriteWidth = 1.0f/(float)spriteCountX;
+    float spriteHeight = 1.0f/(float)spriteCountY;
+    // x, y, u, v per vertex
+    std::vector<float> vertexData;
+    for (int cy = 0; cy < chunksY; cy++) {
+        for (int cx = 0; cx < chunksX; cx++) {
+            Chunk &chunk = chunks[cy * chunksX + cx];
+            chunk.firstVertex = (GLint)(vertexData.size() / 4);
+            for (int y = cy * TILE_CHUNK_SIZE; y < (cy + 1) * TILE_CHUNK_SIZE && y < map.mapHeight; y++) {
+                FlareMapSpan row = map.Row(y);
+                for (int x = cx * TILE_CHUNK_SIZE; x < (cx + 1) * TILE_CHUNK_SIZE && x < map.mapWidth; x++) {
+                    unsigned int tile = row[x];
+                    if (tile == 0) {
+                        continue;
+                    }
+                    float u = (float)(((int)tile) % spriteCountX) / (float)spriteCountX;
+                    float v = (float)(((int)tile) / spriteCountX) / (float)spriteCountY;
+                    float left = tileSize * x;
+                    float right = left + tileSize;
+                    float top = -tileSize * y;
+                    float bottom = top - tileSize;
+                    vertexData.insert(vertexData.end(), {
+                        left, top, u, v,
+                        left, bottom, u, v+spriteHeight,
+                        right, bottom, u+spriteWidth, v+spriteHeight,
+                        left, top, u, v,
+                        right, bottom, u+spriteWidth, v+spriteHeight,
+                        right, top, u+spriteWidth, v
+                    });
+                }
+            }
+            chunk.vertexCount = (GLsizei)(vertexData.size() / 4) - chunk.firstVertex;
+        }
+    }
+    
+    if (vertexBuffer == 0) {
+        glGenBuffers(1, &vertexBuffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TileMapRenderer::Draw(ShaderProgram &program, GLuint texture, float left, float right, float bottom, float top) {
+    chunksDrawn = 0;
+    if (chunks.empty()) {
+        return;
+    }
+    // chunk rows grow downwards, towards negative y
+    int firstX = (int)floorf(left / chunkWorldSize);
+    int lastX = (int)floorf(right / chunkWorldSize);
+    int firstY = (int)floorf(-top / chunkWorldSize);
+    int lastY = (int)floorf(-bottom / chunkWorldSize);
+    if (firstX < 0) { firstX = 0; }
+    if (firstY < 0) { firstY = 0; }
+    if (lastX >= chunksX) { lastX = chunksX - 1; }
+    if (lastY >= chunksY) { lastY = chunksY - 1; }
+    if (firstX > lastX || firstY > lastY) {
+        return;
+    }
+    
+    GLsizei stride = 4 * sizeof(float);
+    program.Use();
+    GLState::BindTexture(texture);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, stride, (void *)0);
+    glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, stride, (void *)(2 * sizeof(float)));
+    GLState::EnableVertexAttribArray(program.positionAttribute);
+    GLState::EnableVertexAttribArray(program.texCoordAttribute);
+    for (int cy = firstY; cy <= lastY; cy++) {
+        const Chunk &first = chunks[cy * chunksX + firstX];
+        const Chunk &last = chunks[cy * chunksX + lastX];
+        GLsizei count = last.firstVertex + last.vertexCount - first.firstVertex;
+        if (count > 0) {
+            GLState::DrawArrays(GL_TRIANGLES, first.firstVertex, count);
+        }
+        chunksDrawn += lastX - firstX + 1;
+    }
+    GLState::DisableVertexAttribArray(program.positionAttribute);
+    GLState::DisableVertexAttribArray(program.texCoordAttribute);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TileMapRenderer::Cleanup() {
+    glDeleteBuffers(1, &vertexBuffer);
+    vertexBuffer = 0;
+    chunks.clear();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "ShaderProgram.h"
+#include "FlareMap.h"
+
+// side length of a chunk, in tiles
+#define TILE_CHUNK_SIZE 16
+
+// Uploads a FlareMap once into a static vertex buffer, ordered chunk by chunk,
+// and draws only the chunks that overlap the camera. Chunks that are next to
+// each other in a row sit next to each other in the buffer, so each visible
+// row of chunks is a single draw call.
+class TileMapRenderer {
+	public:
+		TileMapRenderer();
+
+		void Build(const FlareMap &map, float tileSize, int spriteCountX, int spriteCountY);
+		// camera bounds in world units
+		void Draw(ShaderProgram &program, GLuint texture, float left, float right, float bottom, float top);
+		void Cleanup();
+
+		int chunksDrawn;
+
+	private:
+		struct Chunk {
+			GLint firstVertex;
+			GLsizei vertexCount;
+		};
+
+		GLuint vertexBuffer;
+		std::vector<Chunk> chunks;
+		int chunksX;
+		int chunksY;
+		float chunkWorldSize;
+};
@@ -0,0 +1,229 @@
+#include "XmlReader.h"
+#include <cstdlib>
+#include <cstring>
+
+static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool IsNameChar(char c) {
+    return !IsSpace(c) && c != '=' && c != '/' && c != '>' && c != '"' && c != '\'';
+}
+
+// replaces the five predefined entities and numeric character references
+static std::string Unescape(const char *start, const char *end) {
+    std::string result;
+    result.reserve(end - start);
+    while (start < end) {
+        if (*start != '&') {
+            result += *start++;
+            continue;
+        }
+        const char *semicolon = (const char*)memchr(start, ';', end - start);
+        if (semicolon == NULL) {
+            result.append(start, end);
+            break;
+        }
+        std::string entity(start + 1, semicolon);
+        if (entity == "lt") {
+            result += '<';
+        } else if (entity == "gt") {
+            result += '>';
+        } else if (entity == "amp") {
+            result += '&';
+        } else if (entity == "quot") {
+            result += '"';
+        } else if (entity == "apos") {
+            result += '\'';
+        } else if (entity.size() > 1 && entity[0] == '#') {
+            long code = entity[1] == 'x' ? strtol(entity.c_str() + 2, NULL, 16) : strtol(entity.c_str() + 1, NULL, 10);
+            // everything Tiled writes is ASCII, anything else becomes '?'
+            result += code > 0 && code < 0x80 ? (char)code : '?';
+        } else {
+            result.append(start, semicolon + 1);
+        }
+        start = semicolon + 1;
+    }
+    return result;
+}
+
+XmlReader::XmlReader(const char *data, size_t size)
+    : position(data), end(data + size), text(NULL), textLength(0), depth(0), selfClosing(false) {}
+
+void XmlReader::SkipWhitespace() {
+    while (position < end && IsSpace(*position)) {
+        position++;
+    }
+}
+
+bool XmlReader::SkipPast(const char *terminator) {
+    size_t length = strlen(terminator);
+    for (; position + length <= end; position++) {
+        if (memcmp(position, terminator, length) == 0) {
+            position += length;
+            return true;
+        }
+    }
+    position = end;
+    return false;
+}
+
+bool XmlReader::ReadName(std::string &out) {
+    const char *start = position;
+    while (position < end && IsNameChar(*position)) {
+        position++;
+    }
+    out.assign(start, position);
+    return position > start;
+}
+
+XmlReader::Event XmlReader::Next() {
+    text = NULL;
+    textLength = 0;
+    if (selfClosing) {
+        // <tag/> is reported as a start and an end
+        selfClosing = false;
+        depth--;
+        attributes.clear();
+        return END_ELEMENT;
+    }
+    while (position < end) {
+        if (*position != '<') {
+            const char *start = position;
+            const char *next = (const char*)memchr(position, '<', end - position);
+            position = next ? next : end;
+            const char *last = position;
+            while (start < last && IsSpace(*start)) {
+                start++;
+            }
+            while (last > start && IsSpace(last[-1])) {
+                last--;
+            }
+            if (start == last) {
+                continue;
+            }
+            text = start;
+            textLength = last - start;
+            return TEXT;
+        }
+        size_t remaining = end - position;
+        if (remaining >= 2 && position[1] == '?') {
+            if (!SkipPast("?>")) {
+                return PARSE_ERROR;
+            }
+        } else if (remaining >= 4 && memcmp(position, "<!--", 4) == 0) {
+            if (!SkipPast("-->")) {
+                return PARSE_ERROR;
+            }
+        } else if (remaining >= 9 && memcmp(position, "<![CDATA[", 9) == 0) {
+            position += 9;
+            const char *start = position;
+            if (!SkipPast("]]>")) {
+                return PARSE_ERROR;
+            }
+            text = start;
+            textLength = position - 3 - start;
+            return TEXT;
+        } else if (remaining >= 2 && position[1] == '!') {
+            if (!SkipPast(">")) {
+                return PARSE_ERROR;
+            }
+        } else if (remaining >= 2 && position[1] == '/') {
+            position += 2;
+            if (!ReadName(name)) {
+                return PARSE_ERROR;
+            }
+            SkipWhitespace();
+            if (position >= end || *position != '>') {
+                return PARSE_ERROR;
+            }
+            position++;
+            depth--;
+            attributes.clear();
+            return END_ELEMENT;
+        } else {
+            position++;
+            if (!ReadName(name)) {
+                return PARSE_ERROR;
+            }
+            attributes.clear();
+            while (true) {
+                SkipWhitespace();
+                if (position >= end) {
+                    return PARSE_ERROR;
+                }
+                if (*position == '>') {
+                    position++;
+                    break;
+                }
+                if (*position == '/') {
+                    if (position + 1 >= end || position[1] != '>') {
+                        return PARSE_ERROR;
+                    }
+                    position += 2;
+                    selfClosing = true;
+                    break;
+                }
+                std::string key;
+                if (!ReadName(key)) {
+                    return PARSE_ERROR;
+                }
+                SkipWhitespace();
+                if (position >= end || *position != '=') {
+                    return PARSE_ERROR;
+                }
+                position++;
+                SkipWhitespace();
+                if (position >= end || (*position != '"' && *position != '\'')) {
+                    return PARSE_ERROR;
+                }
+                char quote = *position++;
+                const char *valueEnd = (const char*)memchr(position, quote, end - position);
+                if (valueEnd == NULL) {
+                    return PARSE_ERROR;
+                }
+                attributes.push_back(std::make_pair(key, Unescape(position, valueEnd)));
+                position = valueEnd + 1;
+            }
+            depth++;
+            return START_ELEMENT;
+        }
+    }
+    return END_OF_DOCUMENT;
+}
+
+void XmlReader::SkipElement() {
+    int elementDepth = depth;
+    while (depth >= elementDepth) {
+        Event event = Next();
+        if (event == END_OF_DOCUMENT || event == PARSE_ERROR) {
+            return;
+        }
+    }
+}
+
+bool XmlReader::HasAttribute(const char *key) const {
+    for (const std::pair<std::string, std::string> &attribute : attributes) {
+        if (attribute.first == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string XmlReader::Attribute(const char *key, const std::string &fallback) const {
+    for (const std::pair<std::string, std::string> &attribute : attributes) {
+        if (attribute.first == key) {
+            return attribute.second;
+        }
+    }
+    return fallback;
+}
+
+int XmlReader::IntAttribute(const char *key, int fallback) const {
+    return HasAttribute(key) ? atoi(Attribute(key).c_str()) : fallback;
+}
+
+float XmlReader::FloatAttribute(const char *key, float fallback) const {
+    return HasAttribute(key) ? (float)atof(Attribute(key).c_str()) : fallback;
+}
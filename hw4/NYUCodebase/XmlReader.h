@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Minimal pull parser over an XML document already in memory, enough for
+// Tiled's .tmx and .tsx files. Next() steps through the document one element
+// or text run at a time without building a tree; text is handed out as a
+// pointer into the original buffer, so large layer data is never copied.
+// Doesn't validate, and skips the prolog, comments and doctypes.
+class XmlReader {
+	public:
+		enum Event { START_ELEMENT, END_ELEMENT, TEXT, END_OF_DOCUMENT, PARSE_ERROR };
+
+		XmlReader(const char *data, size_t size);
+
+		Event Next();
+		// skips everything up to and including the end of the element just started
+		void SkipElement();
+
+		// element name for START_ELEMENT and END_ELEMENT
+		const std::string &Name() const { return name; }
+		bool HasAttribute(const char *key) const;
+		std::string Attribute(const char *key, const std::string &fallback = "") const;
+		int IntAttribute(const char *key, int fallback = 0) const;
+		float FloatAttribute(const char *key, float fallback = 0.0f) const;
+
+		// raw text for TEXT, entities are not decoded
+		const char *Text() const { return text; }
+		size_t TextLength() const { return textLength; }
+
+		int Depth() const { return depth; }
+
+	private:
+		bool SkipPast(const char *terminator);
+		bool ReadName(std::string &out);
+		void SkipWhitespace();
+
+		const char *position;
+		const char *end;
+		std::string name;
+		std::vector<std::pair<std::string, std::string> > attributes;
+		const char *text;
+		size_t textLength;
+		int depth;
+		bool selfClosing;
+};
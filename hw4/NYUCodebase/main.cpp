@@ -11,6 +11,15 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "FlareMap.h"
+#include "MapTools.h"
+#include "TileMapRenderer.h"
+#include "TileCollider.h"
+#include "EntityPool.h"
+#include "GameLoop.h"
+#include "Profiler.h"
+#include "AssetLoader.h"
+#include "Random.h"
+#include <chrono>
 #ifdef _WINDOWS
 #define RESOURCE_FOLDER ""
 #else
@@ -19,6 +28,12 @@
 
 #define FIXED_TIMESTEP 0.0166666f
 #define TILE_SIZE 0.1f
+// the tile sheet, for maps whose tileset doesn't describe it
+#define MAP_SHEET_IMAGE "mapSprite.png"
+#define MAP_SHEET_COLUMNS 16
+#define MAP_SHEET_ROWS 8
+// decoded image bytes handed to GL per frame while loading
+#define ASSET_UPLOAD_BUDGET (1024 * 1024)
 
 SDL_Window* displayWindow;
 glm::mat4 modelMatrix = glm::mat4(1.0);
@@ -27,31 +42,34 @@ glm::mat4 projectionMatrix = glm::mat4(1.0);
 ShaderProgram program;
 SDL_Event event;
 bool gameDone = false;
-float lastFrameTicks = 0.0;
-float accumulator = 0.0;
 const Uint8 *keys = SDL_GetKeyboardState(NULL);
 FlareMap map;
+TileCollider collider(map, TILE_SIZE);
 GLuint mapSpriteID;
-std::vector<float> tileMapVertices;
-std::vector<float> tileMapTexCoords;
+TileMapRenderer tileMapRenderer;
 glm::vec3 gravity(0, -7.0, 0);
 glm::vec3 friction(7.0, 0, 0);
+// sprite sheets are decoded on worker threads; the level waits for them. The
+// pack and cache are declared first so they outlive the loader's workers
+AssetPack pack;
+TextureCache textureCache("");
+AssetLoader assets;
+std::chrono::steady_clock::time_point startTime;
+bool firstFrameReported = false;
 
 
-GLuint LoadTexture(const char *filePath) {
-    int w,h,comp;
-    unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-    if (image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
-    }
+double MillisecondsSinceStart() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+GLuint UploadTexture(const unsigned char *image, int w, int h) {
+    PROFILE_SCOPE("UploadTexture");
     GLuint retTexture;
     glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
+    GLState::BindTexture(retTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    stbi_image_free(image);
     return retTexture;
 }
 
@@ -61,7 +79,7 @@ public:
     SheetSprite(unsigned int textureID, int index, int spriteCountX, int spriteCountY)
         : textureID(textureID), index(index), spriteCountX(spriteCountX), spriteCountY(spriteCountY) {}
     void draw(ShaderProgram &program, glm::vec3 position, glm::vec3 size) const {
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::BindTexture(textureID);
         float u = (float)(((int)index) % spriteCountX) / (float) spriteCountX;
         float v = (float)(((int)index) / spriteCountX) / (float) spriteCountY;
         float spriteWidth = 1.0/(float)spriteCountX;
@@ -82,11 +100,11 @@ public:
         program.SetModelMatrix(spriteModelMatrix);
         glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
         glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoords);
-        glEnableVertexAttribArray(program.positionAttribute);
-        glEnableVertexAttribArray(program.texCoordAttribute);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDisableVertexAttribArray(program.positionAttribute);
-        glDisableVertexAttribArray(program.texCoordAttribute);
+        GLState::EnableVertexAttribArray(program.positionAttribute);
+        GLState::EnableVertexAttribArray(program.texCoordAttribute);
+        GLState::DrawArrays(GL_TRIANGLES, 0, 6);
+        GLState::DisableVertexAttribArray(program.positionAttribute);
+        GLState::DisableVertexAttribArray(program.texCoordAttribute);
     }
     unsigned int textureID;
     int index;
@@ -106,61 +124,59 @@ void worldToTileCoordinates(float worldX, float worldY, int *gridX, int *gridY)
 class Entity {
 public:
     Entity(float x, float y, float width, float height)
-        : position(x, y, 0), velocity(0, 0, 0), acceleration(0, 0, 0), size(width, height, 1) {}
-    void draw(ShaderProgram &p) const {
-        sprite.draw(p, position, size);
+        : position(x, y, 0), previousPosition(x, y, 0), spawnPosition(x, y, 0), velocity(0, 0, 0), acceleration(0, 0, 0),
+          size(width, height, 1), groundFriction(1.0f), touchedHazard(false) {}
+    // position to draw at, alpha of the way from the previous step to the current one
+    glm::vec3 renderPosition(float alpha) const {
+        return previousPosition + (position - previousPosition) * alpha;
+    }
+    void draw(ShaderProgram &p, float alpha) const {
+        sprite.draw(p, renderPosition(alpha), size);
+    }
+    void respawn() {
+        position = spawnPosition;
+        previousPosition = spawnPosition;
+        velocity = glm::vec3(0, 0, 0);
     }
     void update(float elapsed) {
+        previousPosition = position;
         // update movement
         // friction only when on ground
         if (collidedBottom) {
-            velocity.x = lerp(velocity.x, 0.0f, elapsed * friction.x);
-            velocity.y = lerp(velocity.y, 0.0f, elapsed * friction.y);
+            velocity.x = lerp(velocity.x, 0.0f, elapsed * friction.x * groundFriction);
+            velocity.y = lerp(velocity.y, 0.0f, elapsed * friction.y * groundFriction);
         }
         velocity.y += gravity.y * elapsed;
         velocity += acceleration * elapsed;
-        position += velocity * elapsed;
-        
-        collidedTop = false;
-        collidedBottom = false;
-        collidedLeft = false;
-        collidedRight = false;
-        int gridX;
-        int gridY;
 
-        // limit to tilemap
-        worldToTileCoordinates(position.x, position.y, &gridX, &gridY);
-        if (0 < gridX && gridX < 50 && 0 < gridY && gridY < 25) {
-            // might need to add more collision points
-            // check bottom collision
-            worldToTileCoordinates(position.x, position.y - size.y/2, &gridX, &gridY);
-            if (map.mapData[gridY][gridX]+1 == 4 || map.mapData[gridY][gridX]+1 == 7 || map.mapData[gridY][gridX]+1 == 18 || map.mapData[gridY][gridX]+1 == 34) {
-                position.y += (-TILE_SIZE * gridY) - (position.y - size.y/2);
-                velocity.y = 0;
-                collidedBottom = true;
-            }
-            // check top collision
-            worldToTileCoordinates(position.x, position.y + size.y/2, &gridX, &gridY);
-            if (map.mapData[gridY][gridX]+1 == 4 || map.mapData[gridY][gridX]+1 == 7 || map.mapData[gridY][gridX]+1 == 18 || map.mapData[gridY][gridX]+1 == 34) {
-                position.y += (-TILE_SIZE * gridY - TILE_SIZE) - (position.y + size.y/2);
-                velocity.y = 0;
-                collidedTop = true;
-            }
-            // check left collision
-            worldToTileCoordinates(position.x - size.x/2, position.y, &gridX, &gridY);
-            if (map.mapData[gridY][gridX]+1 == 4 || map.mapData[gridY][gridX]+1 == 7 || map.mapData[gridY][gridX]+1 == 18 || map.mapData[gridY][gridX]+1 == 34) {
-                position.x += (TILE_SIZE * gridX + TILE_SIZE) - (position.x - size.x/2);
+        // sweep the step's motion through the tiles so fast moves can't tunnel
+        TileMove move = collider.Move(position.x, position.y, size.x, size.y,
+                                      velocity.x * elapsed, velocity.y * elapsed);
+        position.x = move.x;
+        position.y = move.y;
+        for (int i = 0; i < move.contactCount; i++) {
+            const TileContact &contact = move.contacts[i];
+            if (contact.normalX != 0) {
                 velocity.x = 0;
-                collidedLeft = true;
+            } else {
+                velocity.y = 0;
             }
-            // check right collision
-            worldToTileCoordinates(position.x + size.x/2, position.y, &gridX, &gridY);
-            if (map.mapData[gridY][gridX]+1 == 4 || map.mapData[gridY][gridX]+1 == 7 || map.mapData[gridY][gridX]+1 == 18 || map.mapData[gridY][gridX]+1 == 34) {
-                position.x += (TILE_SIZE * gridX) - (position.x + size.x/2);
-                velocity.x = 0;
-                collidedLeft = true;
+            if (contact.normalY > 0) {
+                groundFriction = map.TileProperties(contact.tileX, contact.tileY).friction;
             }
         }
+        collidedTop = move.collidedTop;
+        collidedBottom = move.collidedBottom;
+        collidedLeft = move.collidedLeft;
+        collidedRight = move.collidedRight;
+
+        // hazards hurt when the body or the feet are in one
+        int gridX;
+        int gridY;
+        worldToTileCoordinates(position.x, position.y, &gridX, &gridY);
+        touchedHazard = map.hazard.Test(gridX, gridY);
+        worldToTileCoordinates(position.x, position.y - size.y/2, &gridX, &gridY);
+        touchedHazard = touchedHazard || map.hazard.Test(gridX, gridY);
     }
     bool isColliding(Entity entity) const {
         if (fabs(position.x - entity.position.x) < (size.x/2 + entity.size.x/2) &&
@@ -171,6 +187,8 @@ public:
     }
 
     glm::vec3 position;
+    glm::vec3 previousPosition;
+    glm::vec3 spawnPosition;
     glm::vec3 velocity;
     glm::vec3 acceleration;
     glm::vec3 size;
@@ -181,27 +199,125 @@ public:
     bool collidedBottom;
     bool collidedLeft;
     bool collidedRight;
+    // friction of the tile last stood on
+    float groundFriction;
+    bool touchedHazard;
 };
 
 class Level {
 public:
     Level()
         : player(0.7, -1.9, 0.2, 0.2), key(4.5, -0.3, 0.2, 0.2){}
-    void draw(ShaderProgram &p) const {
-        player.draw(p);
-        key.draw(p);
+    // dino-sized walkers dropped into random open spots on the map. The open
+    // spots are found first, so a map without any just gets no walkers.
+    void spawnNPCs(int count) {
+        if (count <= 0) {
+            return;
+        }
+        std::vector<int> openSpots;
+        for (int gridY = 1; gridY < map.mapHeight - 2; gridY++) {
+            for (int gridX = 1; gridX < map.mapWidth - 2; gridX++) {
+                if (!map.solid.Test(gridX, gridY) && !map.solid.Test(gridX + 1, gridY) &&
+                    !map.solid.Test(gridX, gridY + 1) && !map.solid.Test(gridX + 1, gridY + 1)) {
+                    openSpots.push_back(gridY * map.mapWidth + gridX);
+                }
+            }
+        }
+        if (openSpots.empty()) {
+            std::cout << "No room on the map for NPCs" << std::endl;
+            return;
+        }
+        npcs.Reserve(npcs.Count() + count);
+        for (int i = 0; i < count; i++) {
+            int spot = openSpots[npcRandom.NextInt((uint32_t)openSpots.size())];
+            int gridX = spot % map.mapWidth;
+            int gridY = spot / map.mapWidth;
+            int index = npcs.Add((gridX + 1) * TILE_SIZE, -(gridY + 1) * TILE_SIZE, 0.2f, 0.2f);
+            npcs.accelerationX[index] = npcRandom.NextInt(2) ? 2.0f : -2.0f;
+        }
+    }
+    void draw(ShaderProgram &p, float alpha) {
+        player.draw(p, alpha);
+        key.draw(p, alpha);
+        drawNPCs(p, alpha);
+    }
+    // every NPC in one draw call
+    void drawNPCs(ShaderProgram &p, float alpha) {
+        if (npcs.Count() == 0) {
+            return;
+        }
+        const SheetSprite &sprite = player.sprite;
+        float u = (float)(sprite.index % sprite.spriteCountX) / (float)sprite.spriteCountX;
+        float v = (float)(sprite.index / sprite.spriteCountX) / (float)sprite.spriteCountY;
+        float spriteWidth = 1.0f/(float)sprite.spriteCountX;
+        float spriteHeight = 1.0f/(float)sprite.spriteCountY;
+        npcVertices.clear();
+        npcTexCoords.clear();
+        for (int i = 0; i < npcs.Count(); i++) {
+            float x = npcs.previousX[i] + (npcs.x[i] - npcs.previousX[i]) * alpha;
+            float y = npcs.previousY[i] + (npcs.y[i] - npcs.previousY[i]) * alpha;
+            float halfWidth = npcs.width[i] / 2;
+            float halfHeight = npcs.height[i] / 2;
+            npcVertices.insert(npcVertices.end(), {
+                x - halfWidth, y - halfHeight,
+                x + halfWidth, y + halfHeight,
+                x - halfWidth, y + halfHeight,
+                x + halfWidth, y + halfHeight,
+                x - halfWidth, y - halfHeight,
+                x + halfWidth, y - halfHeight
+            });
+            npcTexCoords.insert(npcTexCoords.end(), {
+                u, v+spriteHeight,
+                u+spriteWidth, v,
+                u, v,
+                u+spriteWidth, v,
+                u, v+spriteHeight,
+                u+spriteWidth, v+spriteHeight
+            });
+        }
+        GLState::BindTexture(sprite.textureID);
+        p.SetModelMatrix(modelMatrix);
+        glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, npcVertices.data());
+        glVertexAttribPointer(p.texCoordAttribute, 2, GL_FLOAT, false, 0, npcTexCoords.data());
+        GLState::EnableVertexAttribArray(p.positionAttribute);
+        GLState::EnableVertexAttribArray(p.texCoordAttribute);
+        GLState::DrawArrays(GL_TRIANGLES, 0, npcs.Count() * 6);
+        GLState::DisableVertexAttribArray(p.positionAttribute);
+        GLState::DisableVertexAttribArray(p.texCoordAttribute);
     }
     void update(float elapsed) {
+        {
+            PROFILE_SCOPE("Update NPCs");
+            npcs.Update(elapsed, collider, gravity.y, friction.x, friction.y);
+            for (int i = 0; i < npcs.Count(); i++) {
+                // turn around at walls
+                if (npcs.flags[i] & (ENTITY_COLLIDED_LEFT | ENTITY_COLLIDED_RIGHT)) {
+                    npcs.accelerationX[i] = -npcs.accelerationX[i];
+                }
+                if (npcs.flags[i] & ENTITY_TOUCHED_HAZARD) {
+                    npcs.Remove(i--);
+                }
+            }
+        }
         player.update(elapsed);
+        if (player.touchedHazard) {
+            player.respawn();
+        }
         if (player.isColliding(key)) {
             key.position.x = -1000;
             key.position.y = -1000;
+            key.previousPosition = key.position;
             std::cout << "You got the key!" << std::endl;
         }
     }
     
     Entity player;
     Entity key;
+    EntityPool npcs;
+    // where NPCs spawn and which way they set off
+    Random npcRandom;
+    std::vector<float> npcVertices;
+    std::vector<float> npcTexCoords;
 };
 
 Level level;
@@ -214,45 +330,70 @@ void Setup() {
     SDL_GL_MakeCurrent(displayWindow, context);
     glViewport(0, 0, 960, 720);
     projectionMatrix = glm::ortho(-1.333, 1.333, -1.0, 1.0, -1.0, 1.0);
-    program.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
-    glUseProgram(program.programID);
+    // everything comes out of one mapped file when the pack has been built
+    // (see --pack), otherwise from the loose files
+    if (pack.Open(RESOURCE_FOLDER"assets.pack")) {
+        assets.pack = &pack;
+        assets.packFolder = RESOURCE_FOLDER;
+    }
+    {
+        PROFILE_SCOPE("Load shaders");
+        AssetView vertex, fragment;
+        if (pack.Find("vertex_textured.glsl", vertex) && pack.Find("fragment_textured.glsl", fragment)) {
+            program.LoadFromSource(vertex.Chars(), vertex.size, fragment.Chars(), fragment.size);
+        } else {
+            program.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
+        }
+    }
+    program.Use();
     program.SetProjectionMatrix(projectionMatrix);
     program.SetViewMatrix(viewMatrix);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    map.Load(RESOURCE_FOLDER"tileMap.txt");
-    mapSpriteID = LoadTexture(RESOURCE_FOLDER"mapSprite.png");
-    level.key.sprite = SheetSprite(mapSpriteID, 86, 16, 8);
-    GLuint dinoSpriteID = LoadTexture(RESOURCE_FOLDER"dinoSprite.png");
-    level.player.sprite = SheetSprite(dinoSpriteID, 0, 24, 1);
-    
-
-    for (int y=0; y < map.mapHeight; y++) {
-        for (int x=0; x < map.mapWidth; x++) {
-            if (map.mapData[y][x] != 0) {
-                float u = (float)(((int)map.mapData[y][x]) % 16) / (float) 16;
-                float v = (float)(((int)map.mapData[y][x]) / 16) / (float) 8;
-                float spriteWidth = 1.0f/(float)16;
-                float spriteHeight = 1.0f/(float)8;
-                tileMapVertices.insert(tileMapVertices.end(), {
-                    TILE_SIZE * x, -TILE_SIZE * y,
-                    TILE_SIZE * x, (-TILE_SIZE * y)-TILE_SIZE,
-                    (TILE_SIZE * x)+TILE_SIZE, (-TILE_SIZE * y)-TILE_SIZE,
-                    TILE_SIZE * x, -TILE_SIZE * y,
-                    (TILE_SIZE * x)+TILE_SIZE, (-TILE_SIZE * y)-TILE_SIZE,
-                    (TILE_SIZE * x)+TILE_SIZE, -TILE_SIZE * y
-                });
-                tileMapTexCoords.insert(tileMapTexCoords.end(), {
-                    u, v,
-                    u, v+(spriteHeight),
-                    u+spriteWidth, v+(spriteHeight),
-                    u, v,
-                    u+spriteWidth, v+(spriteHeight),
-                    u+spriteWidth, v
-                });
-            }
+    {
+        PROFILE_SCOPE("Load map");
+        AssetView mapSource;
+        bool loaded = pack.Find("tileMap.tmx", mapSource) ? map.LoadTMX("tileMap.tmx", &pack)
+                                                          : map.Load(RESOURCE_FOLDER"tileMap.tmx");
+        if (!loaded) {
+            std::cout << "Unable to load tileMap.tmx" << std::endl;
+        }
+    }
+    // the sheet layout comes from the map's tileset, if it has one that
+    // says how the image is laid out
+    std::string sheetImage = MAP_SHEET_IMAGE;
+    int spriteCountX = MAP_SHEET_COLUMNS;
+    int spriteCountY = MAP_SHEET_ROWS;
+    if (!map.tilesets.empty() && map.tilesets[0].columns > 0 && map.tilesets[0].tileCount > 0 &&
+        !map.tilesets[0].image.empty()) {
+        const FlareMapTileset &tileset = map.tilesets[0];
+        sheetImage = tileset.image;
+        spriteCountX = tileset.columns;
+        spriteCountY = (tileset.tileCount + tileset.columns - 1) / tileset.columns;
+    }
+    // decoded images are kept under the per-user data folder between runs
+    char *cachePath = SDL_GetPrefPath("NYUCodebase", "hw4");
+    if (cachePath != NULL) {
+        textureCache.directory = cachePath;
+        assets.cache = &textureCache;
+        SDL_free(cachePath);
+    }
+    assets.QueueImage(RESOURCE_FOLDER + sheetImage, [=](LoadedAsset &asset) {
+        if (asset.ok) {
+            mapSpriteID = UploadTexture(asset.pixels, asset.width, asset.height);
         }
+        level.key.sprite = SheetSprite(mapSpriteID, 86, spriteCountX, spriteCountY);
+    });
+    assets.QueueImage(RESOURCE_FOLDER"dinoSprite.png", [](LoadedAsset &asset) {
+        GLuint dinoSpriteID = asset.ok ? UploadTexture(asset.pixels, asset.width, asset.height) : 0;
+        level.player.sprite = SheetSprite(dinoSpriteID, 0, 24, 1);
+    });
+
+
+    {
+        PROFILE_SCOPE("Build tilemap");
+        tileMapRenderer.Build(map, TILE_SIZE, spriteCountX, spriteCountY);
     }
 }
 
@@ -275,57 +416,99 @@ void ProcessEvents() {
     }
 }
 
+void ReportFirstFrame() {
+    if (!firstFrameReported) {
+        std::cout << "First frame after " << MillisecondsSinceStart() << " ms" << std::endl;
+        firstFrameReported = true;
+    }
+}
+
 void Update(float elapsed) {
-    level.update(elapsed);
+    // nothing moves until there's something to see
+    if (assets.Finished()) {
+        level.update(elapsed);
+    }
 }
 
-void Render() {
+void Render(float alpha) {
     glClearColor(0.07, 0.57, 0.65, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
-    program.SetViewMatrix(glm::translate(viewMatrix, -level.player.position + glm::vec3(0, -0.3, 0)));
+    if (!assets.Finished()) {
+        assets.Update(ASSET_UPLOAD_BUDGET);
+        if (assets.Finished()) {
+            std::cout << "Assets loaded after " << MillisecondsSinceStart() << " ms" << std::endl;
+        }
+        // still loading, the clear color is the loading screen
+        SDL_GL_SwapWindow(displayWindow);
+        ReportFirstFrame();
+        return;
+    }
+    glm::vec3 cameraPosition = level.player.renderPosition(alpha) + glm::vec3(0, 0.3, 0);
+    program.SetViewMatrix(glm::translate(viewMatrix, -cameraPosition));
 
     // Draw level
-    level.draw(program);
+    level.draw(program, alpha);
 
-    // Draw tilemap
+    // Draw tilemap, culled to what the projection can see around the camera
     program.SetModelMatrix(modelMatrix);
-    glEnableVertexAttribArray(program.positionAttribute);
-    glEnableVertexAttribArray(program.texCoordAttribute);
-    glBindTexture(GL_TEXTURE_2D, mapSpriteID);
-    glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, tileMapVertices.data());
-    glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, tileMapTexCoords.data());
-    glDrawArrays(GL_TRIANGLES, 0, tileMapVertices.size()/2);
-    glDisableVertexAttribArray(program.positionAttribute);
-    glDisableVertexAttribArray(program.texCoordAttribute);
+    tileMapRenderer.Draw(program, mapSpriteID, cameraPosition.x - 1.333f, cameraPosition.x + 1.333f,
+                         cameraPosition.y - 1.0f, cameraPosition.y + 1.0f);
     // Display
     SDL_GL_SwapWindow(displayWindow);
     glFlush();
+    ReportFirstFrame();
 }
 
 // Main
 int main(int argc, char *argv[]) {
+    // map tools run instead of the game
+    if (argc >= 4 && std::string(argv[1]) == "--convert-map") {
+        return ConvertMap(argv[2], argv[3]);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-map") {
+        return BenchmarkMapLoad(argc >= 3 ? atol(argv[2]) : 10000000);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-tiles") {
+        return BenchmarkTileLookup();
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-collision") {
+        return BenchmarkCollision(argc >= 3 ? atoi(argv[2]) : 10000);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-entities") {
+        return BenchmarkEntities(argc >= 3 ? atoi(argv[2]) : 10000);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-textures") {
+        return BenchmarkTextureCache(RESOURCE_FOLDER"mapSprite.png", argc >= 3 ? atoi(argv[2]) : 1000);
+    }
+    if (argc >= 4 && std::string(argv[1]) == "--pack") {
+        return AssetPack::Write(argv[2], argv[3], std::vector<std::string>(argv + 4, argv + argc)) ? 0 : 1;
+    }
+    if (argc >= 2 && std::string(argv[1]) == "--bench-pack") {
+        const char *names[] = {"vertex_textured.glsl", "fragment_textured.glsl", "tileMap.tmx", "mapSprite.tsx",
+                               "mapSprite.png", "dinoSprite.png"};
+        return BenchmarkAssetPack(RESOURCE_FOLDER, std::vector<std::string>(names, names + 6),
+                                  argc >= 3 ? atoi(argv[2]) : 1000);
+    }
+    startTime = std::chrono::steady_clock::now();
     Setup();
+    // --npcs N fills the map with walkers
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--npcs") {
+            level.spawnNPCs(atoi(argv[i + 1]));
+        }
+    }
 #ifdef _WINDOWS
     glewInit();
 #endif
-    while (!gameDone) {
-        float ticks = SDL_GetTicks()/1000.0;
-        float elapsed = ticks - lastFrameTicks;
-        lastFrameTicks = ticks;
-        elapsed += accumulator;
-        ProcessEvents();
-        if (elapsed < FIXED_TIMESTEP) {
-            accumulator = elapsed;
-            continue;
-        }
-        while (elapsed >= FIXED_TIMESTEP) {
-            Update(FIXED_TIMESTEP);
-            elapsed -= FIXED_TIMESTEP;
-        }
-        // rendering causes a lot of fps drops... why?
-        // how to draw tilemap without fps drops?
-        Render();
+    GameLoop loop(FIXED_TIMESTEP);
+    loop.Run(gameDone, ProcessEvents, Update, Render);
+    loop.PrintStats();
+    Profiler::PrintFrameStats();
+    std::string profilePrefix = Profiler::CapturePrefix(argc, argv);
+    if (!profilePrefix.empty()) {
+        Profiler::WriteCapture(profilePrefix);
     }
+    tileMapRenderer.Cleanup();
     SDL_Quit();
     return 0;
 }
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TextureCache.h"
+#include "AssetPack.h"
+
+// One asset as a worker left it.
+struct LoadedAsset {
+	LoadedAsset() : ok(false), pixels(0), width(0), height(0), mapping(0), mappingSize(0), bytes(0), byteCount(0) {}
+
+	std::string path;
+	bool ok;
+	// QueueImage: RGBA pixels, from stb_image or mapped out of the texture
+	// cache, released once the callback returns
+	const unsigned char *pixels;
+	int width;
+	int height;
+	// set when pixels point into a cache blob
+	void *mapping;
+	size_t mappingSize;
+	// QueueFile: the file's bytes. QueueSound: its samples, already converted to
+	// the requested format. Callbacks can swap them out to keep them.
+	std::vector<unsigned char> data;
+	// what a QueueFile or QueueSound callback should read: either data, or an
+	// asset pack entry (data is empty then), which lives as long as the pack.
+	// Swapping data away keeps this valid.
+	const unsigned char *bytes;
+	size_t byteCount;
+
+	size_t Size() const { return pixels ? (size_t)width * height * 4 : byteCount; }
+};
+
+// Reads and decodes assets on worker threads, so the main thread can keep
+// drawing frames while they load. Finished assets queue up until the main
+// thread calls Update, which hands them to their callbacks in the order they
+// finished. Callbacks run on the calling thread, so they can create GL
+// textures; Update stops after about byteBudget bytes so a frame never
+// uploads more than that (it always hands over at least one asset, however
+// big).
+class AssetLoader {
+	public:
+		typedef std::function<void(LoadedAsset &asset)> Callback;
+
+		// threadCount 0 picks one less than the number of cores, at least one
+		AssetLoader(int threadCount = 0);
+		~AssetLoader();
+
+		void QueueImage(const std::string &path, const Callback &done);
+		void QueueFile(const std::string &path, const Callback &done);
+		// WAV converted to frequency / format (an SDL_AudioFormat) / channels
+		void QueueSound(const std::string &path, int frequency, unsigned short format, int channels, const Callback &done);
+
+		// runs callbacks for finished assets, returns how many
+		int Update(size_t byteBudget);
+		// everything requested so far has been handed over
+		bool Finished() const { return delivered == requested; }
+		float Progress() const { return requested == 0 ? 1.0f : (float)delivered / requested; }
+
+		// decoded images are looked up here before decoding and stored after;
+		// NULL decodes every time
+		TextureCache *cache;
+		// paths starting with packFolder are looked up in pack first, by the
+		// rest of the path; NULL reads loose files
+		AssetPack *pack;
+		std::string packFolder;
+		int requested;
+		int delivered;
+
+	private:
+		enum Kind { IMAGE_REQUEST, FILE_REQUEST, SOUND_REQUEST };
+		struct Request {
+			Kind kind;
+			std::string path;
+			int frequency;
+			unsigned short format;
+			int channels;
+			Callback done;
+		};
+		struct Result {
+			LoadedAsset asset;
+			Callback done;
+		};
+
+		void Queue(const Request &request);
+		void Work();
+		void Decode(const Request &request, LoadedAsset &asset);
+		bool FindPacked(const std::string &path, AssetView &view) const;
+		static void Release(LoadedAsset &asset);
+
+		int threadCount;
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::deque<Request> requests;
+		std::deque<Result> results;
+		bool stopping;
+};
@@ -0,0 +1,131 @@
+#include "CollisionGrid.h"
+#include <algorithm>
+#include <cmath>
+
+CollisionGrid::CollisionGrid(float cellSize, int maxCellsPerItem)
+    : cellSize(cellSize), maxCellsPerItem(maxCellsPerItem), queryStamp(0) {}
+
+long long CollisionGrid::CellKey(int cellX, int cellY) {
+    return ((long long)cellX << 32) | (unsigned int)cellY;
+}
+
+int CollisionGrid::CellCoordinate(float value) const {
+    return (int)floorf(value / cellSize);
+}
+
+void CollisionGrid::Clear() {
+    items.clear();
+    cells.clear();
+    largeItems.clear();
+    queryStamps.clear();
+}
+
+void CollisionGrid::Unlink(int id) {
+    Item &item = items[id];
+    if (!item.inGrid) {
+        return;
+    }
+    if (item.large) {
+        largeItems.erase(std::find(largeItems.begin(), largeItems.end(), id));
+    } else {
+        for (int y = item.minCellY; y <= item.maxCellY; y++) {
+            for (int x = item.minCellX; x <= item.maxCellX; x++) {
+                std::unordered_map<long long, std::vector<int> >::iterator cell = cells.find(CellKey(x, y));
+                std::vector<int> &ids = cell->second;
+                // order within a cell doesn't matter, swap and pop
+                *std::find(ids.begin(), ids.end(), id) = ids.back();
+                ids.pop_back();
+                if (ids.empty()) {
+                    cells.erase(cell);
+                }
+            }
+        }
+    }
+    item.inGrid = false;
+}
+
+void CollisionGrid::Set(int id, float minX, float minY, float maxX, float maxY) {
+    if (id >= (int)items.size()) {
+        Item empty = {};
+        items.resize(id + 1, empty);
+        queryStamps.resize(id + 1, 0);
+    }
+    int minCellX = CellCoordinate(minX);
+    int minCellY = CellCoordinate(minY);
+    int maxCellX = CellCoordinate(maxX);
+    int maxCellY = CellCoordinate(maxY);
+    Item &item = items[id];
+    bool large = (long long)(maxCellX - minCellX + 1) * (maxCellY - minCellY + 1) > maxCellsPerItem;
+    if (item.inGrid && item.large == large && (large ||
+        (item.minCellX == minCellX && item.minCellY == minCellY &&
+         item.maxCellX == maxCellX && item.maxCellY == maxCellY))) {
+        // still covers the same cells, only the bounds change
+        item.minX = minX;
+        item.minY = minY;
+        item.maxX = maxX;
+        item.maxY = maxY;
+        return;
+    }
+    Unlink(id);
+    item.inGrid = true;
+    item.large = large;
+    item.minCellX = minCellX;
+    item.minCellY = minCellY;
+    item.maxCellX = maxCellX;
+    item.maxCellY = maxCellY;
+    item.minX = minX;
+    item.minY = minY;
+    item.maxX = maxX;
+    item.maxY = maxY;
+    if (large) {
+        largeItems.push_back(id);
+    } else {
+        for (int y = minCellY; y <= maxCellY; y++) {
+            for (int x = minCellX; x <= maxCellX; x++) {
+                cells[CellKey(x, y)].push_back(id);
+            }
+        }
+    }
+}
+
+void CollisionGrid::Remove(int id) {
+    if (id < (int)items.size()) {
+        Unlink(id);
+    }
+}
+
+void CollisionGrid::Query(float minX, float minY, float maxX, float maxY, std::vector<int> &result) const {
+    result.clear();
+    queryStamp++;
+    if (queryStamp == 0) {
+        // wrapped around, forget every old stamp
+        std::fill(queryStamps.begin(), queryStamps.end(), 0);
+        queryStamp = 1;
+    }
+    int minCellX = CellCoordinate(minX);
+    int minCellY = CellCoordinate(minY);
+    int maxCellX = CellCoordinate(maxX);
+    int maxCellY = CellCoordinate(maxY);
+    for (int y = minCellY; y <= maxCellY; y++) {
+        for (int x = minCellX; x <= maxCellX; x++) {
+            std::unordered_map<long long, std::vector<int> >::const_iterator cell = cells.find(CellKey(x, y));
+            if (cell == cells.end()) {
+                continue;
+            }
+            for (int id : cell->second) {
+                if (queryStamps[id] != queryStamp) {
+                    queryStamps[id] = queryStamp;
+                    result.push_back(id);
+                }
+            }
+        }
+    }
+    for (int id : largeItems) {
+        const Item &item = items[id];
+        if (item.maxX >= minX && item.minX <= maxX && item.maxY >= minY && item.minY <= maxY) {
+            result.push_back(id);
+        }
+    }
+    // callers resolve collisions in id order, like a plain loop over the solids would
+    std::sort(result.begin(), result.end());
+}
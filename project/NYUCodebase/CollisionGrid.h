@@ -0,0 +1,50 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+// Uniform-grid broadphase over axis-aligned boxes identified by a small int id
+// (e.g. an index into the vector of solids). Boxes are moved incrementally, so
+// repositioning one only touches the cells it leaves and enters. Boxes that
+// would cover more than maxCellsPerItem cells are kept in a separate list that
+// every query checks, so a few huge platforms don't flood the grid.
+class CollisionGrid {
+	public:
+		CollisionGrid(float cellSize = 0.25f, int maxCellsPerItem = 16);
+
+		void Clear();
+		// inserts id, or moves it if it's already in the grid
+		void Set(int id, float minX, float minY, float maxX, float maxY);
+		void Remove(int id);
+
+		// ids whose boxes may overlap the query box, sorted ascending, without duplicates
+		void Query(float minX, float minY, float maxX, float maxY, std::vector<int> &result) const;
+
+		float cellSize;
+		int maxCellsPerItem;
+
+	private:
+		struct Item {
+			bool inGrid;
+			bool large;
+			int minCellX;
+			int minCellY;
+			int maxCellX;
+			int maxCellY;
+			float minX;
+			float minY;
+			float maxX;
+			float maxY;
+		};
+
+		static long long CellKey(int cellX, int cellY);
+		int CellCoordinate(float value) const;
+		void Unlink(int id);
+
+		std::vector<Item> items;
+		std::unordered_map<long long, std::vector<int> > cells;
+		std::vector<int> largeItems;
+		// per-id stamp of the last query that returned it, to skip duplicates
+		mutable std::vector<unsigned int> queryStamps;
+		mutable unsigned int queryStamp;
+};
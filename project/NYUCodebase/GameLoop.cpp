@@ -0,0 +1,105 @@
+#include "GameLoop.h"
+#include "Profiler.h"
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+GameLoop::GameLoop(float fixedTimestep, int maxStepsPerFrame)
+    : fixedTimestep(fixedTimestep), maxStepsPerFrame(maxStepsPerFrame), sleepWhenIdle(true) {
+    ResetStats();
+}
+
+double GameLoop::Seconds(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::duration<double> >(duration).count();
+}
+
+void GameLoop::Run(bool &done, const std::function<void()> &process,
+                   const std::function<void(float)> &update,
+                   const std::function<void(float)> &render) {
+    double accumulator = 0.0;
+    Clock::time_point runStart = Clock::now();
+    Clock::time_point lastFrame = runStart;
+    while (!done) {
+        Clock::time_point frameStart = Clock::now();
+        Profiler::BeginFrame();
+        double elapsed = Seconds(frameStart - lastFrame);
+        lastFrame = frameStart;
+        if (frames > 0) {
+            RecordFrameInterval(elapsed);
+        }
+        accumulator += elapsed;
+        
+        {
+            PROFILE_SCOPE("Process");
+            process();
+        }
+        int steps = 0;
+        while (accumulator >= fixedTimestep && steps < maxStepsPerFrame) {
+            PROFILE_SCOPE("Update");
+            update(fixedTimestep);
+            accumulator -= fixedTimestep;
+            steps++;
+        }
+        if (accumulator >= fixedTimestep) {
+            // too far behind to catch up, keep only the partial step
+            double kept = fmod(accumulator, (double)fixedTimestep);
+            droppedSeconds += accumulator - kept;
+            accumulator = kept;
+            cappedFrames++;
+        }
+        updates += steps;
+        {
+            PROFILE_SCOPE("Render");
+            render((float)(accumulator / fixedTimestep));
+        }
+        frames++;
+        
+        Clock::time_point frameEnd = Clock::now();
+        // the frame ends before the idle wait, so frame times measure work only
+        Profiler::EndFrame();
+        busySeconds += Seconds(frameEnd - frameStart);
+        if (sleepWhenIdle) {
+            // time left until the next update is due
+            double idle = (fixedTimestep - accumulator) - Seconds(frameEnd - frameStart);
+            if (idle > 0.002) {
+                // sleep short of the deadline, the OS tends to oversleep
+                std::this_thread::sleep_for(std::chrono::microseconds((long long)((idle - 0.001) * 1000000.0)));
+            } else if (idle > 0.0) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    wallSeconds += Seconds(Clock::now() - runStart);
+}
+
+void GameLoop::RecordFrameInterval(double interval) {
+    unsigned long count = frames;
+    double delta = interval - frameIntervalMean;
+    frameIntervalMean += delta / count;
+    frameIntervalM2 += delta * (interval - frameIntervalMean);
+    if (interval > maxFrameInterval) {
+        maxFrameInterval = interval;
+    }
+}
+
+void GameLoop::ResetStats() {
+    frames = 0;
+    updates = 0;
+    cappedFrames = 0;
+    droppedSeconds = 0.0;
+    busySeconds = 0.0;
+    wallSeconds = 0.0;
+    maxFrameInterval = 0.0;
+    frameIntervalMean = 0.0;
+    frameIntervalM2 = 0.0;
+}
+
+void GameLoop::PrintStats() const {
+    double jitter = frames > 2 ? sqrt(frameIntervalM2 / (frames - 2)) : 0.0;
+    double cpu = wallSeconds > 0.0 ? busySeconds / wallSeconds * 100.0 : 0.0;
+    std::cout << "Frames: " << frames << ", updates: " << updates
+              << ", CPU busy: " << cpu << "%" << std::endl;
+    std::cout << "Frame interval: mean " << frameIntervalMean * 1000.0 << " ms, jitter (stddev) "
+              << jitter * 1000.0 << " ms, max " << maxFrameInterval * 1000.0 << " ms" << std::endl;
+    std::cout << "Capped frames: " << cappedFrames << " (" << droppedSeconds * 1000.0 << " ms dropped)" << std::endl;
+}
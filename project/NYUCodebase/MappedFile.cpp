@@ -0,0 +1,57 @@
+#include "MappedFile.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+void *MapFile(const std::string &path, size_t &size) {
+#ifdef _WINDOWS
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER fileSize;
+    void *view = NULL;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            // the view keeps the mapping alive
+            CloseHandle(mapping);
+        }
+        size = (size_t)fileSize.QuadPart;
+    }
+    CloseHandle(file);
+    return view;
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return NULL;
+    }
+    struct stat info;
+    void *view = NULL;
+    if (fstat(file, &info) == 0 && info.st_size > 0) {
+        size = (size_t)info.st_size;
+        view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED) {
+            view = NULL;
+        }
+    }
+    close(file);
+    return view;
+#endif
+}
+
+void UnmapFile(void *view, size_t size) {
+#ifdef _WINDOWS
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
@@ -0,0 +1,225 @@
+#include "MusicStream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// how long the decoder sleeps when the ring is full; a small fraction of it
+#define MUSIC_DECODER_SLEEP_MS 2
+
+static uint32_t ReadLE32(const unsigned char *bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint16_t ReadLE16(const unsigned char *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+MusicStream::MusicStream() : underrunFrames(0), loops(0), file(NULL), filePosition(0), memory(NULL), sourceSize(0),
+    dataOffset(0), dataSize(0), position(0), channels(0), bytesPerSample(0), looping(false),
+    readFrames(0), writtenFrames(0), ended(true), stopping(false) {}
+
+MusicStream::~MusicStream() {
+    Close();
+}
+
+bool MusicStream::Open(const std::string &fileName, int frequency, bool loop) {
+    Close();
+    file = fopen(fileName.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    sourceSize = size > 0 ? (size_t)size : 0;
+    filePosition = 0;
+    if (!Start(frequency, loop)) {
+        std::cout << "Unable to stream " << fileName << ", it needs to be an 8 or 16-bit PCM WAV at " << frequency << " Hz\n";
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool MusicStream::Open(const unsigned char *data, size_t size, int frequency, bool loop) {
+    Close();
+    memory = data;
+    sourceSize = size;
+    if (!Start(frequency, loop)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MusicStream::Close() {
+    stopping = true;
+    if (decoder.joinable()) {
+        decoder.join();
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    file = NULL;
+    memory = NULL;
+    sourceSize = 0;
+    readFrames = 0;
+    writtenFrames = 0;
+    ended = true;
+}
+
+bool MusicStream::Start(int frequency, bool loop) {
+    if (!ReadHeader(frequency)) {
+        return false;
+    }
+    looping = loop;
+    position = 0;
+    readFrames = 0;
+    writtenFrames = 0;
+    underrunFrames = 0;
+    loops = 0;
+    ended = false;
+    stopping = false;
+    // the first ringful is decoded here, so the first callback has something
+    while (Refill()) {}
+    decoder = std::thread(&MusicStream::Decode, this);
+    return true;
+}
+
+bool MusicStream::ReadHeader(int frequency) {
+    unsigned char header[12];
+    if (ReadSource(0, header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    bool haveFormat = false;
+    size_t offset = sizeof(header);
+    while (true) {
+        unsigned char chunkHeader[8];
+        if (ReadSource(offset, chunkHeader, sizeof(chunkHeader)) != sizeof(chunkHeader)) {
+            return false;
+        }
+        size_t size = ReadLE32(chunkHeader + 4);
+        if (memcmp(chunkHeader, "fmt ", 4) == 0) {
+            unsigned char format[16];
+            if (size < sizeof(format) || ReadSource(offset + 8, format, sizeof(format)) != sizeof(format)) {
+                return false;
+            }
+            // tag 1 is plain PCM
+            int bitsPerSample = ReadLE16(format + 14);
+            channels = ReadLE16(format + 2);
+            bytesPerSample = bitsPerSample / 8;
+            if (ReadLE16(format) != 1 || (channels != 1 && channels != 2) ||
+                (bitsPerSample != 8 && bitsPerSample != 16) || (int)ReadLE32(format + 4) != frequency) {
+                return false;
+            }
+            haveFormat = true;
+        } else if (memcmp(chunkHeader, "data", 4) == 0) {
+            if (!haveFormat) {
+                return false;
+            }
+            dataOffset = offset + 8;
+            // a file cut short plays what's there
+            dataSize = std::min(size, sourceSize > dataOffset ? sourceSize - dataOffset : 0);
+            dataSize -= dataSize % (channels * bytesPerSample);
+            return dataSize > 0;
+        }
+        // chunks are padded to an even size
+        offset += 8 + size + (size & 1);
+    }
+}
+
+size_t MusicStream::ReadSource(size_t offset, void *buffer, size_t size) {
+    if (memory != NULL) {
+        if (offset >= sourceSize) {
+            return 0;
+        }
+        size = std::min(size, sourceSize - offset);
+        memcpy(buffer, memory + offset, size);
+        return size;
+    }
+    // reads are sequential apart from a loop, so this rarely seeks
+    if (offset != filePosition && fseek(file, (long)offset, SEEK_SET) != 0) {
+        return 0;
+    }
+    size_t count = fread(buffer, 1, size, file);
+    filePosition = offset + count;
+    return count;
+}
+
+bool MusicStream::Refill() {
+    int frameBytes = channels * bytesPerSample;
+    int chunkFrames = MUSIC_READ_CHUNK / frameBytes;
+    unsigned long long written = writtenFrames.load(std::memory_order_relaxed);
+    unsigned long long space = MUSIC_RING_FRAMES - (written - readFrames.load(std::memory_order_acquire));
+    if (space < (unsigned long long)chunkFrames || ended) {
+        return false;
+    }
+    if (position == dataSize) {
+        if (!looping) {
+            ended = true;
+            return false;
+        }
+        position = 0;
+        loops++;
+    }
+    size_t bytes = std::min((size_t)chunkFrames * frameBytes, dataSize - position);
+    size_t count = ReadSource(dataOffset + position, chunk, bytes);
+    count -= count % frameBytes;
+    if (count == 0) {
+        // unreadable from here on, treat it as the end of the track
+        position = dataSize;
+        return false;
+    }
+    position += count;
+
+    int frames = (int)(count / frameBytes);
+    for (int i = 0; i < frames; i++) {
+        const unsigned char *frame = chunk + i * frameBytes;
+        int16_t left, right;
+        if (bytesPerSample == 2) {
+            left = (int16_t)ReadLE16(frame);
+            right = channels == 2 ? (int16_t)ReadLE16(frame + 2) : left;
+        } else {
+            // 8-bit WAV samples are unsigned
+            left = (int16_t)((frame[0] - 128) << 8);
+            right = channels == 2 ? (int16_t)((frame[1] - 128) << 8) : left;
+        }
+        int16_t *slot = ring + ((written + i) % MUSIC_RING_FRAMES) * 2;
+        slot[0] = left;
+        slot[1] = right;
+    }
+    writtenFrames.store(written + frames, std::memory_order_release);
+    return true;
+}
+
+void MusicStream::Decode() {
+    while (!stopping && !ended) {
+        if (!Refill()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(MUSIC_DECODER_SLEEP_MS));
+        }
+    }
+}
+
+void MusicStream::Read(int16_t *out, int frames) {
+    unsigned long long read = readFrames.load(std::memory_order_relaxed);
+    unsigned long long buffered = writtenFrames.load(std::memory_order_acquire) - read;
+    int count = (int)std::min(buffered, (unsigned long long)frames);
+    // at most two runs, either side of the end of the ring
+    int start = (int)(read % MUSIC_RING_FRAMES);
+    int first = std::min(count, MUSIC_RING_FRAMES - start);
+    memcpy(out, ring + start * 2, first * 2 * sizeof(int16_t));
+    memcpy(out + first * 2, ring, (count - first) * 2 * sizeof(int16_t));
+    readFrames.store(read + count, std::memory_order_release);
+    if (count < frames) {
+        memset(out + count * 2, 0, (frames - count) * 2 * sizeof(int16_t));
+        if (!ended) {
+            underrunFrames += frames - count;
+        }
+    }
+}
+
+bool MusicStream::Finished() const {
+    return ended && readFrames == writtenFrames;
+}
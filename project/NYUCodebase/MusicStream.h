@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+// ring of decoded stereo frames, about 190 ms at 44.1 kHz
+#define MUSIC_RING_FRAMES 8192
+// bytes of the file read per refill
+#define MUSIC_READ_CHUNK 4096
+
+// A PCM WAV track decoded a chunk at a time on its own thread into a fixed
+// ring of stereo S16 frames, which the audio callback drains with Read. Only
+// the ring and one read chunk are ever resident, however long the track is.
+// Read never blocks or allocates: the two sides share nothing but the ring's
+// atomic read and write positions, and if the decoder falls behind the
+// callback gets silence and an underrun is counted instead of waiting.
+// Looping seeks the decoder back to the first sample, so the ring carries on
+// straight from the last frame into the first with no gap.
+//
+// 8 or 16-bit, mono or stereo; the track has to be at the output frequency.
+class MusicStream {
+	public:
+		MusicStream();
+		~MusicStream();
+		MusicStream(const MusicStream&) = delete;
+		MusicStream &operator=(const MusicStream&) = delete;
+
+		// fills the ring before returning, so playback starts without an
+		// underrun. false if the file isn't a WAV this can play.
+		bool Open(const std::string &fileName, int frequency, bool loop);
+		// the same from memory, like an asset pack entry, which has to stay
+		// valid until Close
+		bool Open(const unsigned char *data, size_t size, int frequency, bool loop);
+		void Close();
+		bool IsOpen() const { return decoder.joinable(); }
+
+		// audio thread only: fills frames stereo frames, with silence past the
+		// end of a track that doesn't loop
+		void Read(int16_t *out, int frames);
+		// everything decoded has been played and the track doesn't loop
+		bool Finished() const;
+
+		static size_t MemoryUsed() { return sizeof(int16_t) * 2 * MUSIC_RING_FRAMES + MUSIC_READ_CHUNK; }
+
+		std::atomic<unsigned long> underrunFrames;
+		std::atomic<unsigned long> loops;
+
+	private:
+		bool Start(int frequency, bool loop);
+		bool ReadHeader(int frequency);
+		// reads up to size bytes at offset in the source, returns how many
+		size_t ReadSource(size_t offset, void *buffer, size_t size);
+		// decodes one chunk into the ring, false if there's no room yet or
+		// nothing left to decode
+		bool Refill();
+		void Decode();
+
+		FILE *file;
+		size_t filePosition;
+		const unsigned char *memory;
+		size_t sourceSize;
+
+		// the data chunk, and where the decoder has got to in it
+		size_t dataOffset;
+		size_t dataSize;
+		size_t position;
+		int channels;
+		int bytesPerSample;
+		bool looping;
+
+		int16_t ring[MUSIC_RING_FRAMES * 2];
+		unsigned char chunk[MUSIC_READ_CHUNK];
+		// frame counts, only ever increasing; the difference is what's buffered
+		std::atomic<unsigned long long> readFrames;
+		std::atomic<unsigned long long> writtenFrames;
+		std::atomic<bool> ended;
+		std::atomic<bool> stopping;
+		std::thread decoder;
+};
@@ -0,0 +1,41 @@
+#include "Random.h"
+
+Random::Random(uint64_t seed, uint64_t stream) {
+    Seed(seed, stream);
+}
+
+void Random::Seed(uint64_t seed, uint64_t stream) {
+    // the increment must be odd
+    state = 0;
+    increment = (stream << 1) | 1;
+    Next();
+    state += seed;
+    Next();
+}
+
+uint32_t Random::Next() {
+    uint64_t oldState = state;
+    state = oldState * 6364136223846793005ULL + increment;
+    uint32_t xorShifted = (uint32_t)(((oldState >> 18) ^ oldState) >> 27);
+    uint32_t rotation = (uint32_t)(oldState >> 59);
+    return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+}
+
+uint32_t Random::NextInt(uint32_t bound) {
+    if (bound == 0) {
+        return 0;
+    }
+    // reject the values below 2^32 % bound so every remainder is equally likely
+    uint32_t threshold = (0u - bound) % bound;
+    while (true) {
+        uint32_t value = Next();
+        if (value >= threshold) {
+            return value % bound;
+        }
+    }
+}
+
+float Random::NextFloat() {
+    // top 24 bits, so the result is exactly representable and never reaches 1
+    return (Next() >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+// PCG32 (pcg-random.org): small, fast and statistically solid. Generators with
+// the same seed but different streams produce independent sequences, so each
+// system can own one without perturbing anyone else's, and a given seed gives
+// the same numbers on every platform.
+class Random {
+	public:
+		Random(uint64_t seed = 0x853c49e6748fea9bULL, uint64_t stream = 0);
+
+		void Seed(uint64_t seed, uint64_t stream = 0);
+
+		uint32_t Next();
+		// uniform in [0, bound), without modulo bias
+		uint32_t NextInt(uint32_t bound);
+		// uniform in [0, 1)
+		float NextFloat();
+
+	private:
+		uint64_t state;
+		uint64_t increment;
+};
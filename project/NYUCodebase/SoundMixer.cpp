@@ -0,0 +1,192 @@
+#include "SoundMixer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <iostream>
+
+SoundMixer::SoundMixer() : frequency(0), bufferFrames(0), device(0), voiceCount(0), music(NULL), musicVolume(1.0f) {
+    ResetStats();
+}
+
+SoundMixer::~SoundMixer() {
+    Close();
+}
+
+bool SoundMixer::Open(int frequency, int bufferFrames) {
+    Close();
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        std::cout << "Unable to start audio: " << SDL_GetError() << "\n";
+        return false;
+    }
+    SDL_AudioSpec want;
+    SDL_AudioSpec have;
+    SDL_zero(want);
+    want.freq = frequency;
+    want.format = AUDIO_S16SYS;
+    want.channels = 2;
+    want.samples = (Uint16)bufferFrames;
+    want.callback = Callback;
+    want.userdata = this;
+    // no changes allowed: SDL converts if the hardware wants something else
+    device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (device == 0) {
+        std::cout << "Unable to open audio: " << SDL_GetError() << "\n";
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+    this->frequency = have.freq;
+    this->bufferFrames = have.samples;
+    mixBuffer.assign((size_t)have.samples * 2, 0.0f);
+    musicBuffer.assign(mixBuffer.size(), 0);
+    voiceCount = 0;
+    SDL_PauseAudioDevice(device, 0);
+    return true;
+}
+
+void SoundMixer::Close() {
+    if (device == 0) {
+        return;
+    }
+    SDL_CloseAudioDevice(device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    device = 0;
+    voiceCount = 0;
+    music = NULL;
+    // nothing reads the queue any more, so it's safe to empty from here
+    Trigger trigger;
+    while (triggers.Pop(trigger)) {}
+}
+
+bool SoundMixer::Play(const MixerSound &sound, float volume) {
+    if (sound.samples == NULL || sound.frames <= 0) {
+        return false;
+    }
+    Trigger trigger = {sound.samples, sound.frames, volume, Profiler::Now()};
+    if (!triggers.Push(trigger)) {
+        triggersDropped++;
+        return false;
+    }
+    return true;
+}
+
+void SoundMixer::PlayMusic(MusicStream *stream, float volume) {
+    musicVolume = volume;
+    music = stream;
+}
+
+void SoundMixer::StopMusic() {
+    music = NULL;
+    // the callback may have loaded the pointer just before; once it has
+    // finished this buffer it can't be using the stream any more
+    if (device != 0) {
+        SDL_LockAudioDevice(device);
+        SDL_UnlockAudioDevice(device);
+    }
+}
+
+void SoundMixer::Callback(void *userdata, Uint8 *stream, int length) {
+    ((SoundMixer *)userdata)->Fill((int16_t *)stream, length / (int)(2 * sizeof(int16_t)));
+}
+
+void SoundMixer::Fill(int16_t *out, int frames) {
+    unsigned long long now = Profiler::Now();
+    Trigger trigger;
+    while (triggers.Pop(trigger)) {
+        unsigned long long latency = now > trigger.postedAt ? now - trigger.postedAt : 0;
+        triggerLatencyTotal += latency;
+        if (latency > triggerLatencyMax) {
+            triggerLatencyMax = latency;
+        }
+        triggersMixed++;
+        StartVoice(trigger);
+    }
+    Mix(out, frames);
+    unsigned long long fillTime = Profiler::Now() - now;
+    if (fillTime > fillTimeMax) {
+        fillTimeMax = fillTime;
+    }
+}
+
+void SoundMixer::StartVoice(const Trigger &trigger) {
+    int slot = voiceCount;
+    if (voiceCount == MIXER_MAX_VOICES) {
+        // steal the voice that's been playing longest
+        slot = 0;
+        for (int i = 1; i < voiceCount; i++) {
+            if (voices[i].position > voices[slot].position) {
+                slot = i;
+            }
+        }
+    } else {
+        voiceCount++;
+    }
+    Voice voice = {trigger.samples, trigger.frames, 0, trigger.volume};
+    voices[slot] = voice;
+}
+
+// mix[i] += samples[i] * volume over a whole run of interleaved samples
+static void AddScaled(float *__restrict mix, const int16_t *__restrict samples, int count, float volume) {
+    for (int i = 0; i < count; i++) {
+        mix[i] += samples[i] * volume;
+    }
+}
+
+static void ClampToS16(const float *__restrict mix, int16_t *__restrict out, int count) {
+    for (int i = 0; i < count; i++) {
+        float sample = std::min(std::max(mix[i], -32768.0f), 32767.0f);
+        out[i] = (int16_t)sample;
+    }
+}
+
+void SoundMixer::Mix(int16_t *out, int frames) {
+    // in chunks of the mix buffer, in case SDL asks for more than it said
+    if (mixBuffer.empty()) {
+        mixBuffer.assign(2 * 1024, 0.0f);
+        musicBuffer.assign(mixBuffer.size(), 0);
+    }
+    int chunkFrames = (int)mixBuffer.size() / 2;
+    MusicStream *stream = music;
+    while (frames > 0) {
+        int count = std::min(frames, chunkFrames);
+        float *mix = mixBuffer.data();
+        std::fill(mix, mix + count * 2, 0.0f);
+        if (stream != NULL) {
+            stream->Read(musicBuffer.data(), count);
+            AddScaled(mix, musicBuffer.data(), count * 2, musicVolume);
+        }
+        for (int i = 0; i < voiceCount; i++) {
+            Voice &voice = voices[i];
+            int run = std::min(count, voice.frames - voice.position);
+            AddScaled(mix, voice.samples + voice.position * 2, run * 2, voice.volume);
+            voice.position += run;
+        }
+        // swap-and-pop the voices that ran out
+        for (int i = voiceCount - 1; i >= 0; i--) {
+            if (voices[i].position >= voices[i].frames) {
+                voices[i] = voices[--voiceCount];
+            }
+        }
+        ClampToS16(mix, out, count * 2);
+        out += count * 2;
+        frames -= count;
+    }
+}
+
+void SoundMixer::ResetStats() {
+    triggersMixed = 0;
+    triggersDropped = 0;
+    triggerLatencyTotal = 0;
+    triggerLatencyMax = 0;
+    fillTimeMax = 0;
+}
+
+void SoundMixer::PrintStats() const {
+    unsigned long mixed = triggersMixed;
+    double bufferMilliseconds = frequency > 0 ? bufferFrames * 1000.0 / frequency : 0.0;
+    std::cout << "Sound triggers: " << mixed << " mixed, " << triggersDropped << " dropped" << std::endl;
+    if (mixed > 0) {
+        std::cout << "Trigger to mix: " << triggerLatencyTotal / 1e6 / mixed << " ms average, "
+                  << triggerLatencyMax / 1e6 << " ms max, plus up to " << bufferMilliseconds
+                  << " ms of buffer (" << bufferFrames << " frames at " << frequency << " Hz)" << std::endl;
+    }
+    std::cout << "Longest callback: " << fillTimeMax / 1e3 << " us" << std::endl;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <SDL.h>
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+#include "SpscQueue.h"
+#include "MusicStream.h"
+
+#define MIXER_MAX_VOICES 32
+#define MIXER_QUEUE_SIZE 64
+
+// Interleaved stereo AUDIO_S16SYS samples at the mixer's frequency. The
+// caller keeps them alive for as long as they might be playing.
+struct MixerSound {
+	MixerSound() : samples(0), frames(0) {}
+
+	const int16_t *samples;
+	int frames;
+};
+
+// Sound effects mixed in our own SDL audio callback, so the device buffer can
+// be a few milliseconds long instead of SDL_mixer's. Play never blocks: it
+// posts a trigger to a lock-free single-producer queue that the callback
+// drains at the start of each buffer, so it must only be called from one
+// thread (the game thread). Triggers start a voice from a fixed pool; when all
+// are busy the one that's furthest along is cut off. Voices are summed into a
+// float buffer and clamped back to 16 bits in loops simple enough for the
+// compiler to vectorize. A MusicStream can play underneath them.
+class SoundMixer {
+	public:
+		SoundMixer();
+		~SoundMixer();
+
+		// stereo AUDIO_S16SYS; bufferFrames is the device buffer, in frames
+		bool Open(int frequency, int bufferFrames);
+		void Close();
+
+		// false if the trigger queue is full (the sound is dropped)
+		bool Play(const MixerSound &sound, float volume = 1.0f);
+		// the stream has to stay open until StopMusic, or Close
+		void PlayMusic(MusicStream *stream, float volume);
+		// returns once the callback is done with the stream
+		void StopMusic();
+
+		// starts the posted triggers, then mixes frames stereo frames into out.
+		// This is what the callback does; it's public so the mixer can be
+		// driven and benchmarked without a device.
+		void Fill(int16_t *out, int frames);
+
+		void ResetStats();
+		void PrintStats() const;
+
+		int frequency;
+		int bufferFrames;
+
+		// trigger stats; Play counts drops, the callback everything else
+		std::atomic<unsigned long> triggersMixed;
+		std::atomic<unsigned long> triggersDropped;
+		// time from Play to the callback that starts the sound, in nanoseconds;
+		// the sound is heard up to one buffer after that
+		std::atomic<unsigned long long> triggerLatencyTotal;
+		std::atomic<unsigned long long> triggerLatencyMax;
+		// longest the callback took to fill a buffer, in nanoseconds
+		std::atomic<unsigned long long> fillTimeMax;
+
+	private:
+		struct Trigger {
+			const int16_t *samples;
+			int frames;
+			float volume;
+			unsigned long long postedAt;
+		};
+		struct Voice {
+			const int16_t *samples;
+			int frames;
+			int position;
+			float volume;
+		};
+
+		static void Callback(void *userdata, Uint8 *stream, int length);
+		void StartVoice(const Trigger &trigger);
+		void Mix(int16_t *out, int frames);
+
+		SDL_AudioDeviceID device;
+		SpscQueue<Trigger, MIXER_QUEUE_SIZE> triggers;
+		// only touched by the callback while the device is open
+		Voice voices[MIXER_MAX_VOICES];
+		int voiceCount;
+		std::vector<float> mixBuffer;
+		std::atomic<MusicStream*> music;
+		std::atomic<float> musicVolume;
+		std::vector<int16_t> musicBuffer;
+};
@@ -0,0 +1,120 @@
+#include "SpriteBatch.h"
+#include <cmath>
+
+#define FLOATS_PER_VERTEX 8
+#define VERTICES_PER_QUAD 6
+
+SpriteBatch::SpriteBatch() : colorAttribute(0), drawCalls(0), quadCount(0),
+    vertexBuffer(0), whiteTexture(0), batchTexture(0) {}
+
+void SpriteBatch::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
+    program.Load(vertexShaderFile, fragmentShaderFile);
+    Setup();
+}
+
+void SpriteBatch::LoadFromSource(const char *vertexSource, size_t vertexLength, const char *fragmentSource, size_t fragmentLength) {
+    program.LoadFromSource(vertexSource, vertexLength, fragmentSource, fragmentLength);
+    Setup();
+}
+
+void SpriteBatch::Setup() {
+    colorAttribute = glGetAttribLocation(program.programID, "vertexColor");
+    
+    glGenBuffers(1, &vertexBuffer);
+    
+    // untextured quads sample a single white texel so everything shares one shader
+    unsigned char white[] = {255, 255, 255, 255};
+    glGenTextures(1, &whiteTexture);
+    GLState::BindTexture(whiteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    
+    vertexData.reserve(1024 * VERTICES_PER_QUAD * FLOATS_PER_VERTEX);
+}
+
+void SpriteBatch::Cleanup() {
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteTextures(1, &whiteTexture);
+    program.Cleanup();
+}
+
+void SpriteBatch::BeginFrame() {
+    drawCalls = 0;
+    quadCount = 0;
+}
+
+void SpriteBatch::SetViewMatrix(const glm::mat4 &matrix) {
+    // pending quads were submitted against the old view
+    Flush();
+    program.SetViewMatrix(matrix);
+}
+
+void SpriteBatch::DrawQuad(const glm::vec3 &position, const glm::vec3 &size, float angle, const glm::vec4 &color) {
+    PushQuad(whiteTexture, position, size, angle, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), color);
+}
+
+void SpriteBatch::DrawTexturedQuad(GLuint texture, const glm::vec3 &position, const glm::vec3 &size, float angle,
+                                   const glm::vec4 &uvRect, const glm::vec4 &tint) {
+    PushQuad(texture, position, size, angle, uvRect, tint);
+}
+
+void SpriteBatch::PushQuad(GLuint texture, const glm::vec3 &position, const glm::vec3 &size, float angle,
+                           const glm::vec4 &uvRect, const glm::vec4 &color) {
+    if (texture != batchTexture) {
+        Flush();
+        batchTexture = texture;
+    }
+    // same transform as translate * rotate * scale on a unit quad, done on the CPU
+    float radians = angle * (3.1415926f / 180.0f);
+    float c = cosf(radians);
+    float s = sinf(radians);
+    float hw = size.x * 0.5f;
+    float hh = size.y * 0.5f;
+    float corners[4][2] = {{-hw, hh}, {-hw, -hh}, {hw, hh}, {hw, -hh}};
+    float uvs[4][2] = {
+        {uvRect.x, uvRect.y},
+        {uvRect.x, uvRect.y + uvRect.w},
+        {uvRect.x + uvRect.z, uvRect.y},
+        {uvRect.x + uvRect.z, uvRect.y + uvRect.w}
+    };
+    // two triangles: top left, bottom left, top right / top right, bottom left, bottom right
+    static const int order[VERTICES_PER_QUAD] = {0, 1, 2, 2, 1, 3};
+    for (int i = 0; i < VERTICES_PER_QUAD; ++i) {
+        const float *corner = corners[order[i]];
+        const float *uv = uvs[order[i]];
+        vertexData.insert(vertexData.end(), {
+            position.x + corner[0] * c - corner[1] * s,
+            position.y + corner[0] * s + corner[1] * c,
+            uv[0], uv[1],
+            color.r, color.g, color.b, color.a
+        });
+    }
+    quadCount++;
+}
+
+void SpriteBatch::Flush() {
+    if (vertexData.empty()) {
+        return;
+    }
+    GLsizei stride = FLOATS_PER_VERTEX * sizeof(float);
+    program.Use();
+    GLState::BindTexture(batchTexture);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    // respecify the whole store every flush so the driver can orphan the old one
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_STREAM_DRAW);
+    glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, stride, (void *)0);
+    glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, stride, (void *)(2 * sizeof(float)));
+    glVertexAttribPointer(colorAttribute, 4, GL_FLOAT, false, stride, (void *)(4 * sizeof(float)));
+    GLState::EnableVertexAttribArray(program.positionAttribute);
+    GLState::EnableVertexAttribArray(program.texCoordAttribute);
+    GLState::EnableVertexAttribArray(colorAttribute);
+    GLState::DrawArrays(GL_TRIANGLES, 0, (GLsizei)(vertexData.size() / FLOATS_PER_VERTEX));
+    GLState::DisableVertexAttribArray(program.positionAttribute);
+    GLState::DisableVertexAttribArray(program.texCoordAttribute);
+    GLState::DisableVertexAttribArray(colorAttribute);
+    // everything else still draws from client-side arrays
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    drawCalls++;
+    vertexData.clear();
+}
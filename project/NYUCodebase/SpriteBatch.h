@@ -0,0 +1,54 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <vector>
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "ShaderProgram.h"
+
+// Collects world-space quads into one streamed vertex buffer and draws them
+// with as few glDrawArrays calls as possible. Quads are flushed whenever the
+// bound texture changes, or when Flush() is called explicitly (e.g. before
+// drawing something that doesn't go through the batch).
+class SpriteBatch {
+	public:
+		SpriteBatch();
+
+		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
+		void LoadFromSource(const char *vertexSource, size_t vertexLength, const char *fragmentSource, size_t fragmentLength);
+		void Cleanup();
+
+		void BeginFrame();
+		void SetViewMatrix(const glm::mat4 &matrix);
+
+		// solid colored quad, rotated by angle (degrees) around its center
+		void DrawQuad(const glm::vec3 &position, const glm::vec3 &size, float angle, const glm::vec4 &color);
+		// textured quad sampling the (u, v, width, height) rectangle of texture
+		void DrawTexturedQuad(GLuint texture, const glm::vec3 &position, const glm::vec3 &size, float angle,
+							  const glm::vec4 &uvRect, const glm::vec4 &tint);
+
+		void Flush();
+
+		ShaderProgram program;
+		GLuint colorAttribute;
+
+		// stats for the current frame, reset by BeginFrame()
+		int drawCalls;
+		int quadCount;
+
+	private:
+		// everything Load does once the program is built
+		void Setup();
+		void PushQuad(GLuint texture, const glm::vec3 &position, const glm::vec3 &size, float angle,
+					  const glm::vec4 &uvRect, const glm::vec4 &color);
+
+		GLuint vertexBuffer;
+		GLuint whiteTexture;
+		GLuint batchTexture;
+		std::vector<float> vertexData;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+// Bounded queue for exactly one producer thread and one consumer thread, with
+// no locks: each side only stores its own index, publishing it with release
+// ordering after touching the slot, so neither can ever block the other. That
+// makes it safe to use from an audio callback. Capacity must be a power of two;
+// one slot is kept empty to tell full from empty.
+template <typename T, size_t Capacity>
+class SpscQueue {
+	public:
+		SpscQueue() : head(0), tail(0) {
+			static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+		}
+
+		// producer only; false if the queue is full
+		bool Push(const T &item) {
+			size_t position = tail.load(std::memory_order_relaxed);
+			size_t next = (position + 1) & (Capacity - 1);
+			if (next == head.load(std::memory_order_acquire)) {
+				return false;
+			}
+			items[position] = item;
+			tail.store(next, std::memory_order_release);
+			return true;
+		}
+
+		// consumer only; false if the queue is empty
+		bool Pop(T &item) {
+			size_t position = head.load(std::memory_order_relaxed);
+			if (position == tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+			item = items[position];
+			head.store((position + 1) & (Capacity - 1), std::memory_order_release);
+			return true;
+		}
+
+	private:
+		T items[Capacity];
+		// on separate cache lines so the two threads don't keep stealing one
+		// line from each other
+		alignas(64) std::atomic<size_t> head;
+		alignas(64) std::atomic<size_t> tail;
+};
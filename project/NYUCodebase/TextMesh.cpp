@@ -0,0 +1,77 @@
+#include "TextMesh.h"
+#include <vector>
+
+TextMesh::TextMesh() : vertexBuffer(0), vertexCount(0) {}
+
+void TextMesh::Build(const std::string &text, float size, float spacing) {
+    float character_size = 1.0/16.0f;
+    // x, y, u, v per vertex, six vertices per glyph
+    std::vector<float> vertexData;
+    vertexData.reserve(text.size() * 6 * 4);
+    for (int i=0; i < text.size(); ++i) {
+        int spriteIndex = (int)text[i];
+        float texture_x = (float)(spriteIndex % 16) / 16.0f;
+        float texture_y = (float)(spriteIndex / 16) / 16.0f;
+        float left = ((size+spacing) * i) + (-0.5f * size);
+        float right = ((size+spacing) * i) + (0.5f * size);
+        vertexData.insert(vertexData.end(), {
+            left, 0.5f * size, texture_x, texture_y,
+            left, -0.5f * size, texture_x, texture_y + character_size,
+            right, 0.5f * size, texture_x + character_size, texture_y,
+            right, -0.5f * size, texture_x + character_size, texture_y + character_size,
+            right, 0.5f * size, texture_x + character_size, texture_y,
+            left, -0.5f * size, texture_x, texture_y + character_size,
+        });
+    }
+    if (vertexBuffer == 0) {
+        glGenBuffers(1, &vertexBuffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vertexCount = (GLsizei)(text.size() * 6);
+}
+
+void TextMesh::Draw(ShaderProgram &program, GLuint fontTexture) const {
+    GLsizei stride = 4 * sizeof(float);
+    program.Use();
+    GLState::BindTexture(fontTexture);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, stride, (void *)0);
+    glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, stride, (void *)(2 * sizeof(float)));
+    GLState::EnableVertexAttribArray(program.positionAttribute);
+    GLState::EnableVertexAttribArray(program.texCoordAttribute);
+    GLState::DrawArrays(GL_TRIANGLES, 0, vertexCount);
+    GLState::DisableVertexAttribArray(program.positionAttribute);
+    GLState::DisableVertexAttribArray(program.texCoordAttribute);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TextMesh::Cleanup() {
+    glDeleteBuffers(1, &vertexBuffer);
+    vertexBuffer = 0;
+    vertexCount = 0;
+}
+
+bool TextMeshKey::operator<(const TextMeshKey &other) const {
+    if (size != other.size) { return size < other.size; }
+    if (spacing != other.spacing) { return spacing < other.spacing; }
+    return text < other.text;
+}
+
+const TextMesh *TextMeshCache::Get(const std::string &text, float size, float spacing) {
+    TextMeshKey key = {text, size, spacing};
+    std::map<TextMeshKey, TextMesh>::iterator it = meshes.find(key);
+    if (it == meshes.end()) {
+        it = meshes.insert(std::make_pair(key, TextMesh())).first;
+        it->second.Build(text, size, spacing);
+    }
+    return &it->second;
+}
+
+void TextMeshCache::Cleanup() {
+    for (std::map<TextMeshKey, TextMesh>::iterator it = meshes.begin(); it != meshes.end(); ++it) {
+        it->second.Cleanup();
+    }
+    meshes.clear();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <string>
+#include <map>
+#include "ShaderProgram.h"
+
+// Glyph quads for one string from a 16x16 font sheet, stored in a static
+// vertex buffer so drawing it is one bind and one draw.
+class TextMesh {
+	public:
+		TextMesh();
+
+		void Build(const std::string &text, float size, float spacing);
+		void Draw(ShaderProgram &program, GLuint fontTexture) const;
+		void Cleanup();
+
+		GLuint vertexBuffer;
+		GLsizei vertexCount;
+};
+
+struct TextMeshKey {
+	std::string text;
+	float size;
+	float spacing;
+
+	bool operator<(const TextMeshKey &other) const;
+};
+
+// Owns every TextMesh built so far, keyed by string, size and spacing.
+// Returned pointers stay valid until Cleanup().
+class TextMeshCache {
+	public:
+		const TextMesh *Get(const std::string &text, float size, float spacing);
+		void Cleanup();
+
+	private:
+		std::map<TextMeshKey, TextMesh> meshes;
+};
@@ -1,3 +1,8 @@
+// Building with HEADLESS defined leaves out everything that needs SDL, GL or
+// audio and replaces main() with a simulation-only runner (see the bottom of
+// this file). It builds with just a C++11 compiler:
+//   g++ -std=c++11 -O2 -DHEADLESS main.cpp CollisionGrid.cpp Random.cpp -o blockdash-headless
+#ifndef HEADLESS
 #ifdef _WINDOWS
 #include <GL/glew.h>
 #endif
@@ -7,11 +12,43 @@
 #include <SDL_image.h>
 #include <SDL_mixer.h>
 #include "ShaderProgram.h"
-#include "glm/mat4x4.hpp"
-#include "glm/gtc/matrix_transform.hpp"
+#include "SpriteBatch.h"
+#include "TextMesh.h"
+#include "GameLoop.h"
+#include "Profiler.h"
+#include "AssetLoader.h"
+#include "SoundMixer.h"
+#include "MappedFile.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#include "FlareMap.h"
+#endif
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+#ifndef HEADLESS
+#ifdef _WINDOWS
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+#endif
+#include <cerrno>
+#include <climits>
+#ifdef HEADLESS
+#include <random>
+#endif
+#include "glm/mat4x4.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "CollisionGrid.h"
+#include "Random.h"
 #ifdef _WINDOWS
 #define RESOURCE_FOLDER ""
 #else
@@ -19,47 +56,181 @@
 #endif
 
 #define FIXED_TIMESTEP 0.0166666
+// decoded asset bytes handed to GL per frame while loading
+#define ASSET_UPLOAD_BUDGET (1024 * 1024)
+// sound effect buffer, about 6 ms at 44.1 kHz (--audio-buffer overrides it)
+#define SOUND_BUFFER_FRAMES 256
+// what SDL_mixer played them at, 100 out of 128
+#define SOUND_VOLUME 0.78f
+// likewise for the music, 60 out of 128
+#define MUSIC_VOLUME 0.47f
+#define DEFAULT_SEED 1
+// random streams, one per system that draws numbers
+#define OBSTACLE_STREAM 1
 
-SDL_Window* displayWindow;
 glm::mat4 modelMatrix(1.0);
 glm::mat4 viewMatrix(1.0);
 glm::mat4 projectionMatrix(1.0);
-ShaderProgram program;
-ShaderProgram programTex;
-SDL_Event event;
 bool gameDone = false;
-float lastFrameTicks = 0.0;
-float accumulator = 0.0;
 glm::vec3 gravity(0.0, -2.0, 0.0);
-const Uint8 *keys = SDL_GetKeyboardState(NULL);
 enum GameMode { MENU, LEVEL };
+#ifndef HEADLESS
+SDL_Window* displayWindow;
+ShaderProgram programTex;
+SpriteBatch batch;
+SDL_Event event;
+const Uint8 *keys = SDL_GetKeyboardState(NULL);
 GLuint font;
-// sounds
+TextMeshCache textMeshes;
+// sound effects go through our own low latency mixer, and so does the music
+// when there's a WAV of it; an mp3 falls back to SDL_mixer. All of them play
+// from memory kept here.
 Mix_Music *music;
-Mix_Chunk *jump;
-Mix_Chunk *landing;
+MusicStream musicStream;
+SoundMixer mixer;
+int soundBufferFrames = SOUND_BUFFER_FRAMES;
+MixerSound jump;
+MixerSound landing;
+std::vector<unsigned char> musicData;
+std::vector<unsigned char> jumpSamples;
+std::vector<unsigned char> landingSamples;
+// assets are read and decoded on worker threads while the menu is up; the
+// pack and cache are declared first so they outlive the loader's workers
+AssetPack pack;
+TextureCache textureCache("");
+AssetLoader assets;
+std::chrono::steady_clock::time_point startTime;
+bool firstFrameReported = false;
+bool assetsReported = false;
+#endif
 
 
 /*
  Functions
 */
-GLuint LoadTexture(const char *filePath) {
-    int w,h,comp;
-    unsigned char* image = stbi_load(filePath, &w, &h, &comp, STBI_rgb_alpha);
-    if (image == NULL) {
-        std::cout << "Unable to load image. Make sure the path is correct\n";
-        assert(false);
+// parses a whole decimal argument into [minimum, maximum]
+bool parseArgument(const char *text, long minimum, long maximum, long &value) {
+    char *end;
+    errno = 0;
+    long parsed = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || parsed < minimum || parsed > maximum) {
+        return false;
     }
+    value = parsed;
+    return true;
+}
+
+#ifndef HEADLESS
+GLuint UploadTexture(const unsigned char *image, int w, int h) {
+    PROFILE_SCOPE("UploadTexture");
     GLuint retTexture;
     glGenTextures(1, &retTexture);
-    glBindTexture(GL_TEXTURE_2D, retTexture);
+    GLState::BindTexture(retTexture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    stbi_image_free(image);
     return retTexture;
 }
 
+// a sound playing straight from samples, which have to outlive it
+MixerSound MakeSound(LoadedAsset &asset, std::vector<unsigned char> &samples) {
+    MixerSound sound;
+    if (!asset.ok) {
+        return sound;
+    }
+    samples.swap(asset.data);
+    sound.samples = (const int16_t *)samples.data();
+    sound.frames = (int)(samples.size() / (2 * sizeof(int16_t)));
+    return sound;
+}
+
+// Writes interleaved stereo 16-bit samples as a PCM WAV, to a temporary name
+// first so a half-written one is never picked up.
+bool writeWAV(const std::string &path, const int16_t *samples, size_t frames, int frequency) {
+    uint32_t dataBytes = (uint32_t)(frames * 2 * sizeof(int16_t));
+    uint32_t header[] = {0x46464952, 36 + dataBytes, 0x45564157, 0x20746d66, 16, 0x00020001,
+                         (uint32_t)frequency, (uint32_t)frequency * 4, 0x00100004, 0x61746164, dataBytes};
+    std::string temporaryPath = path + ".tmp";
+    FILE *out = fopen(temporaryPath.c_str(), "wb");
+    if (out == NULL) {
+        return false;
+    }
+    bool ok = fwrite(header, sizeof(header), 1, out) == 1 &&
+              fwrite(samples, 2 * sizeof(int16_t), frames, out) == frames;
+    ok = fclose(out) == 0 && ok;
+    ok = ok && rename(temporaryPath.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        remove(temporaryPath.c_str());
+    }
+    return ok;
+}
+
+// Decodes a compressed track into a WAV that MusicStream can play at
+// frequency. SDL_mixer does the decoding, so it has to be open; it only loads
+// an mp3 whole like this from 2.0.2 on. The whole track is in memory while
+// it's converted, so only --convert-music does this, never the game.
+bool convertMusic(const unsigned char *data, size_t size, const std::string &wavPath, int frequency) {
+    PROFILE_SCOPE("Convert music");
+    Mix_Chunk *chunk = Mix_LoadWAV_RW(SDL_RWFromConstMem(data, (int)size), 1);
+    if (chunk == NULL) {
+        std::cout << "Unable to convert the music for streaming: " << Mix_GetError() << std::endl;
+        return false;
+    }
+    int deviceFrequency;
+    Uint16 deviceFormat;
+    int deviceChannels;
+    Mix_QuerySpec(&deviceFrequency, &deviceFormat, &deviceChannels);
+    SDL_AudioCVT cvt;
+    if (SDL_BuildAudioCVT(&cvt, deviceFormat, (Uint8)deviceChannels, deviceFrequency, AUDIO_S16LSB, 2, frequency) < 0) {
+        Mix_FreeChunk(chunk);
+        return false;
+    }
+    // converts in place, in a buffer big enough for the largest intermediate step
+    std::vector<unsigned char> samples((size_t)chunk->alen * std::max(cvt.len_mult, 1));
+    memcpy(samples.data(), chunk->abuf, chunk->alen);
+    cvt.buf = samples.data();
+    cvt.len = (int)chunk->alen;
+    Mix_FreeChunk(chunk);
+    if (cvt.needed && SDL_ConvertAudio(&cvt) < 0) {
+        return false;
+    }
+    size_t length = cvt.needed ? cvt.len_cvt : cvt.len;
+    return writeWAV(wavPath, (const int16_t *)samples.data(), length / (2 * sizeof(int16_t)), frequency);
+}
+
+// Earlier builds converted the mp3 while the game ran and left the result in
+// the per-user data folder as Chiptronical-<hash>.wav, a few tens of MB that
+// nothing reads any more.
+void removeConvertedMusic(const std::string &directory) {
+#ifdef _WINDOWS
+    _finddata_t found;
+    intptr_t search = _findfirst((directory + "Chiptronical-*.wav*").c_str(), &found);
+    if (search == -1) {
+        return;
+    }
+    do {
+        remove((directory + found.name).c_str());
+    } while (_findnext(search, &found) == 0);
+    _findclose(search);
+#else
+    DIR *folder = opendir(directory.c_str());
+    if (folder == NULL) {
+        return;
+    }
+    while (dirent *entry = readdir(folder)) {
+        if (strncmp(entry->d_name, "Chiptronical-", 13) == 0 && strstr(entry->d_name, ".wav") != NULL) {
+            remove((directory + entry->d_name).c_str());
+        }
+    }
+    closedir(folder);
+#endif
+}
+
+double millisecondsSinceStart() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+#endif
+
 float mapValue(float value, float srcMin, float srcMax, float dstMin, float dstMax) {
     float retVal = dstMin + ((value - srcMin)/(srcMax-srcMin) * (dstMax-dstMin));
     if(retVal < dstMin) {
@@ -75,71 +246,41 @@ float mapValue(float value, float srcMin, float srcMax, float dstMin, float dstM
 /*
  Classes
 */
+#ifndef HEADLESS
 class TextBox{
 public:
     TextBox(float x, float y, float fontSize, std::string text)
-    : position(x, y, 0), fontSize(fontSize), text(text) {}
-    void draw(ShaderProgram &p) {
+    : position(x, y, 0), fontSize(fontSize), text(text), mesh(nullptr) {}
+    void draw(ShaderProgram &p) const {
+        // only look the mesh up again when the text or size changed since it was built
+        if (mesh == nullptr || meshText != text || meshFontSize != fontSize) {
+            mesh = textMeshes.Get(text, fontSize, 0);
+            meshText = text;
+            meshFontSize = fontSize;
+        }
         glm::mat4 textBoxModelMatrix = glm::translate(modelMatrix, position);
         p.SetModelMatrix(textBoxModelMatrix);
-        DrawText(p, font, text, fontSize, 0);
-    }
-    void DrawText(ShaderProgram &program, int fontTexture, std::string text, float size, float spacing) {
-        float character_size = 1.0/16.0f;
-        std::vector<float> vertexData;
-        std::vector<float> texCoordData;
-        for (int i=0; i < text.size(); ++i) {
-            int spriteIndex = (int)text[i];
-            float texture_x = (float)(spriteIndex % 16) / 16.0f;
-            float texture_y = (float)(spriteIndex / 16) / 16.0f;
-            vertexData.insert(vertexData.end(), {
-                ((size+spacing) * i) + (-0.5f * size), 0.5f * size,
-                ((size+spacing) * i) + (-0.5f * size), -0.5f * size,
-                ((size+spacing) * i) + (0.5f * size), 0.5f * size,
-                ((size+spacing) * i) + (0.5f * size), -0.5f * size,
-                ((size+spacing) * i) + (0.5f * size), 0.5f * size,
-                ((size+spacing) * i) + (-0.5f * size), -0.5f * size,
-            });
-            texCoordData.insert(texCoordData.end(), {
-                texture_x, texture_y,
-                texture_x, texture_y + character_size,
-                texture_x + character_size, texture_y,
-                texture_x + character_size, texture_y + character_size,
-                texture_x + character_size, texture_y,
-                texture_x, texture_y + character_size,
-            });
-        }
-        glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertexData.data());
-        glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, texCoordData.data());
-        glEnableVertexAttribArray(program.positionAttribute);
-        glEnableVertexAttribArray(program.texCoordAttribute);
-        glBindTexture(GL_TEXTURE_2D, fontTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6 * (int)text.size());
-        glDisableVertexAttribArray(program.positionAttribute);
-        glDisableVertexAttribArray(program.texCoordAttribute);
+        mesh->Draw(p, font);
     }
     
     glm::vec3 position;
     std::string text;
     float fontSize;
+    mutable const TextMesh *mesh;
+    mutable std::string meshText;
+    mutable float meshFontSize;
 };
+#endif
 
 class Entity {
 public:
     Entity(float x, float y, float width, float height, float r, float g, float b, float a)
     : position(x, y, 0), size(width, height, 1), color(r, g, b, a), angle(0), scaleX(1), scaleY(1) {}
-    void draw(ShaderProgram &p) const {
-        glm::mat4 entityModelMatrix = glm::translate(modelMatrix, position);
-        entityModelMatrix = glm::rotate(entityModelMatrix, angle * (3.1415926f / 180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        entityModelMatrix = glm::scale(glm::scale(entityModelMatrix, size), glm::vec3(scaleX, scaleY, 1.0f));
-        p.SetModelMatrix(entityModelMatrix);
-        float vertices[] = {-0.5, 0.5, -0.5, -0.5, 0.5, 0.5, 0.5, 0.5, -0.5, -0.5, 0.5, -0.5};
-        glVertexAttribPointer(p.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-        glEnableVertexAttribArray(p.positionAttribute);
-        p.SetColor(color.r, color.g, color.b, color.a);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDisableVertexAttribArray(p.positionAttribute);
+#ifndef HEADLESS
+    void draw(SpriteBatch &batch) const {
+        batch.DrawQuad(position, glm::vec3(size.x * scaleX, size.y * scaleY, 1.0f), angle, color);
     }
+#endif
     
     glm::vec3 position;
     glm::vec3 size;
@@ -149,12 +290,30 @@ public:
     float scaleY;
 };
 
+// keeps grid's box for solids[id] in sync with the entity's position
+void setGridBox(CollisionGrid &grid, const std::vector<Entity> &solids, int id) {
+    const Entity &solid = solids[id];
+    grid.Set(id, solid.position.x - solid.size.x/2, solid.position.y - solid.size.y/2,
+             solid.position.x + solid.size.x/2, solid.position.y + solid.size.y/2);
+}
+
+// what a player is asking to do this tick, however it was read
+struct PlayerInput {
+    PlayerInput() : up(false), left(false), right(false) {}
+    bool up;
+    bool left;
+    bool right;
+};
+
 class Player : public Entity {
 public:
     Player(float x, float y, float width, float height, float r, float g, float b, float a, float velocityX, float velocityY)
-        : Entity(x, y, width, height, r, g, b, a), velocity(velocityX, velocityY, 0),
-          acceleration(0, 0, 0), angleVelocity(0) {}
-    void update(float elapsed, const std::vector<Entity> &platforms, const std::vector<Entity> &obstacles, Player &player) {
+        : Entity(x, y, width, height, r, g, b, a), previousPosition(x, y, 0), velocity(velocityX, velocityY, 0),
+          acceleration(0, 0, 0), angleVelocity(0), onGround(false), jumped(false), landed(false) {}
+    // a NULL grid tests against every solid in the vector
+    void update(float elapsed, const std::vector<Entity> &platforms, const CollisionGrid *platformGrid,
+                const std::vector<Entity> &obstacles, const CollisionGrid *obstacleGrid, Player &player) {
+        previousPosition = position;
         velocity.y += gravity.y * elapsed;
         velocity += acceleration * elapsed;
         // collision bools
@@ -164,8 +323,8 @@ public:
         collidedRight = false;
         // check x collision
         position.x += velocity.x * elapsed;
-        adjustCollisionsX(platforms);
-        adjustCollisionsX(obstacles);
+        adjustCollisionsX(platforms, platformGrid);
+        adjustCollisionsX(obstacles, obstacleGrid);
         if (isColliding(player)) {
             float penetration = fabs(fabs(position.x - player.position.x) - fabs(size.x/2 + player.size.x/2));
             if (position.x < player.position.x) {
@@ -179,8 +338,8 @@ public:
         }
         // check y collision
         position.y += velocity.y * elapsed;
-        adjustCollisionsY(platforms);
-        adjustCollisionsY(obstacles);
+        adjustCollisionsY(platforms, platformGrid);
+        adjustCollisionsY(obstacles, obstacleGrid);
         if (isColliding(player)) {
             float penetration = fabs(fabs(position.y - player.position.y) - fabs(size.y/2 + player.size.y/2));
             if (position.y < player.position.y) {
@@ -202,33 +361,56 @@ public:
         } else if (velocity.x > 0){
             angleVelocity -= 15;
         }
-        if (collidedBottom && !onGround) { Mix_PlayChannel(-1, landing, 0); onGround = true; }
+        if (collidedBottom && !onGround) { landed = true; onGround = true; }
         if (!collidedBottom) { onGround = false; }
         scaleY = mapValue(fabs(velocity.y), 0.0, 7.0, 1.0, 2.0);
         scaleX = mapValue(fabs(velocity.y), 7.0, 0.0, 0.4, 1.0);
     }
-    void process(const Uint8 *keys) {
-        if (keys[upKey] && collidedBottom) {
+#ifndef HEADLESS
+    // draws between the last two simulated positions, alpha of the way along
+    void draw(SpriteBatch &batch, float alpha) const {
+        glm::vec3 renderPosition = previousPosition + (position - previousPosition) * alpha;
+        batch.DrawQuad(renderPosition, glm::vec3(size.x * scaleX, size.y * scaleY, 1.0f), angle, color);
+    }
+#endif
+    void process(const PlayerInput &input) {
+        if (input.up && collidedBottom) {
             velocity.y = 1.25;
-            Mix_PlayChannel(-1, jump, 0);
+            jumped = true;
         }
-        if (keys[rightKey]) {
+        if (input.right) {
             velocity.x = 0.5;
-        } else if (keys[leftKey]) {
+        } else if (input.left) {
             velocity.x = -0.5;
         } else {
             velocity.x = 0;
         }
     }
-    bool isColliding(Entity entity) const {
+    bool isColliding(const Entity &entity) const {
         if (fabs(position.x - entity.position.x) < (size.x/2 + entity.size.x/2) &&
             fabs(position.y - entity.position.y) < (size.y/2 + entity.size.y/2)) {
             return true;
         }
         return false;
     }
-    void adjustCollisionsX(const std::vector<Entity> &solids) {
-        for (const Entity &solid : solids) {
+    // fills candidates with the indices of the solids that could touch the player
+    void findCandidates(const std::vector<Entity> &solids, const CollisionGrid *grid) {
+        if (grid) {
+            // resolving one collision can push the player up to about its own size,
+            // so look that far around it to see everything a plain loop would
+            grid->Query(position.x - size.x * 1.5f, position.y - size.y * 1.5f,
+                        position.x + size.x * 1.5f, position.y + size.y * 1.5f, candidates);
+        } else {
+            candidates.resize(solids.size());
+            for (size_t i = 0; i < solids.size(); i++) {
+                candidates[i] = (int)i;
+            }
+        }
+    }
+    void adjustCollisionsX(const std::vector<Entity> &solids, const CollisionGrid *grid) {
+        findCandidates(solids, grid);
+        for (int i : candidates) {
+            const Entity &solid = solids[i];
             if (isColliding(solid)) {
                 float penetration = fabs(fabs(position.x - solid.position.x) - fabs(size.x/2 + solid.size.x/2));
                 if (position.x < solid.position.x) {
@@ -242,8 +424,10 @@ public:
             }
         }
     }
-    void adjustCollisionsY(const std::vector<Entity> &solids) {
-        for (const Entity &solid : solids) {
+    void adjustCollisionsY(const std::vector<Entity> &solids, const CollisionGrid *grid) {
+        findCandidates(solids, grid);
+        for (int i : candidates) {
+            const Entity &solid = solids[i];
             if (isColliding(solid)) {
                 float penetration = fabs(fabs(position.y - solid.position.y) - fabs(size.y/2 + solid.size.y/2));
                 if (position.y < solid.position.y) {
@@ -258,6 +442,7 @@ public:
         }
     }
 
+    glm::vec3 previousPosition;
     glm::vec3 velocity;
     glm::vec3 acceleration;
     float angleVelocity;
@@ -266,41 +451,56 @@ public:
     bool collidedLeft;
     bool collidedRight;
     bool onGround;
-    int upKey;
-    int rightKey;
-    int leftKey;
+    // sound cues raised by the simulation, cleared once they've been played
+    bool jumped;
+    bool landed;
+    // broadphase scratch space
+    std::vector<int> candidates;
 };
 
 class Camera {
 public:
     Camera(float x, float y, float width, float height, float velocityX, float velocityY)
-        : position(x, y, 0), size(width, height, 0), velocity(velocityX, velocityY, 0) {}
-    void setViewMatrix(ShaderProgram &p) const {
+        : position(x, y, 0), previousPosition(x, y, 0), size(width, height, 0), velocity(velocityX, velocityY, 0) {}
+#ifndef HEADLESS
+    void setViewMatrix(SpriteBatch &batch, float alpha) const {
         glm::vec3 scale(size.x/3.2, size.y/2.0, 0);
-        p.SetViewMatrix(glm::scale(glm::translate(viewMatrix, -position), scale));
+        glm::vec3 renderPosition = previousPosition + (position - previousPosition) * alpha;
+        batch.SetViewMatrix(glm::scale(glm::translate(viewMatrix, -renderPosition), scale));
     }
+#endif
     void move(float elapsed) {
+        previousPosition = position;
         position += velocity * elapsed;
     }
     glm::vec3 position;
+    glm::vec3 previousPosition;
     glm::vec3 size;
     glm::vec3 velocity;
 };
 
 class Level {
 public:
-    Level()
+    // a new game starts with 45 obstacles and a restarted one with 50
+    Level(int obstacleCount = 45, int restartObstacleCount = 50, float obstacleSpawnRange = 3.2f,
+          uint64_t seed = DEFAULT_SEED)
         : player1(0, 1.0, 0.099, 0.099, 0.75, 0.33, 0.33, 0.8, 0.3, 0),
           player2(0, 1.0, 0.099, 0.099, 0.33, 0.33, 0.75, 0.8, 0.3, 0),
-          camera(0, 0, 3.2, 2.0, 0.3, 0),
-          paused(false), escPressed(false), goToMenu(false), restart(false), gameOver(false) {
-              // player key bindings
-              player1.upKey = SDL_SCANCODE_UP;
-              player1.rightKey = SDL_SCANCODE_RIGHT;
-              player1.leftKey = SDL_SCANCODE_LEFT;
-              player2.upKey = SDL_SCANCODE_W;
-              player2.rightKey = SDL_SCANCODE_D;
-              player2.leftKey = SDL_SCANCODE_A;
+          restartLayoutSaved(false), camera(0, 0, 3.2, 2.0, 0.3, 0),
+          obstacleSeed(seed), obstacleRandom(seed, OBSTACLE_STREAM),
+          obstacleCount(obstacleCount), restartObstacleCount(restartObstacleCount),
+          obstacleSpawnRange(obstacleSpawnRange), broadphase(true),
+          paused(false), escPressed(false), goToMenu(false), restart(false), gameOver(false)
+#ifndef HEADLESS
+          , pausedTitle(-0.45, 0.4, 0.18, "Paused"),
+          pausedResume(-0.504, 0.0, 0.05, "Press space to resume"),
+          pausedRestart(-0.418, -0.15, 0.05, "Press R to restart"),
+          pausedQuit(-0.66, -0.3, 0.05, "Press Q to quit to main menu"),
+          gameOverTitle(-0.66, 0.4, 0.18, "Game Over"),
+          gameOverRestart(-0.418, -0.10, 0.05, "Press R to restart"),
+          gameOverQuit(-0.66, -0.25, 0.05, "Press Q to quit to main menu")
+#endif
+          {
               // background panels
               background.push_back(Entity(-1.8, 0, 0.4, 2.0, 0.26, 0.26, 0.26, 1));
               background.push_back(Entity(-1.4, 0, 0.4, 2.0, 0.4, 0.4, 0.4, 1));
@@ -319,58 +519,62 @@ public:
               platforms.push_back(Entity(6.4, -10.5, 6.4, 20, 0.30, 0.45, 0.45, 1));
               left_platform_i = 0;
               right_platform_i = platforms.size() - 1;
-              // obstacles
-              for (int i=0; i < 45; i++) {
-                  obstacles.push_back(Entity(-10, -0.45, 0.1, 0.1, 0.75, 0.75, 0.33, 1));
-              }
+              buildPlatformGrid();
+              buildObstacles(obstacleCount);
     }
-    void render(ShaderProgram &p, ShaderProgram &pTex) const {
-        camera.setViewMatrix(p);
+#ifndef HEADLESS
+    void render(SpriteBatch &batch, ShaderProgram &pTex, float alpha) const {
+        camera.setViewMatrix(batch, alpha);
         for (const Entity &panel : background) {
-            panel.draw(p);
+            panel.draw(batch);
         }
-        player1.draw(p);
-        player2.draw(p);
+        player1.draw(batch, alpha);
+        player2.draw(batch, alpha);
         for (const Entity &platform : platforms) {
-            platform.draw(p);
+            platform.draw(batch);
         }
         for (const Entity &obstacle : obstacles) {
-            obstacle.draw(p);
+            obstacle.draw(batch);
         }
         if (paused) {
             Entity shade(camera.position.x, camera.position.y, 3.2, 2.0, 0.2, 0.2, 0.2, 0.4);
-            TextBox pause(-0.45, 0.4, 0.18, "Paused");
-            TextBox resume(-0.504, 0.0, 0.05, "Press space to resume");
-            TextBox restart(-0.418, -0.15, 0.05, "Press R to restart");
-            TextBox quit(-0.66, -0.3, 0.05, "Press Q to quit to main menu");
-            shade.draw(p);
-            pause.draw(pTex);
-            resume.draw(pTex);
-            restart.draw(pTex);
-            quit.draw(pTex);
+            shade.draw(batch);
+            batch.Flush();
+            pausedTitle.draw(pTex);
+            pausedResume.draw(pTex);
+            pausedRestart.draw(pTex);
+            pausedQuit.draw(pTex);
         } else if (gameOver) {
             Entity shade(camera.position.x, camera.position.y, 3.2, 2.0, 0.2, 0.2, 0.2, 0.4);
-            TextBox pause(-0.66, 0.4, 0.18, "Game Over");
-            TextBox restart(-0.418, -0.10, 0.05, "Press R to restart");
-            TextBox quit(-0.66, -0.25, 0.05, "Press Q to quit to main menu");
-            shade.draw(p);
-            pause.draw(pTex);
-            restart.draw(pTex);
-            quit.draw(pTex);
+            shade.draw(batch);
+            batch.Flush();
+            gameOverTitle.draw(pTex);
+            gameOverRestart.draw(pTex);
+            gameOverQuit.draw(pTex);
+        } else {
+            batch.Flush();
         }
     }
+#endif
     void update(float elapsed, GameMode &mode) {
         if (goToMenu) { mode = MENU; goToMenu = false; reset(); return; }
         if (restart) { restart = false; reset(); return; }
         if (!paused && !gameOver) {
             camera.move(elapsed);
-            player1.update(elapsed, platforms, obstacles, player2);
-            player2.update(elapsed, platforms, obstacles, player1);
+            const CollisionGrid *pGrid = broadphase ? &platformGrid : NULL;
+            const CollisionGrid *oGrid = broadphase ? &obstacleGrid : NULL;
+            player1.update(elapsed, platforms, pGrid, obstacles, oGrid, player2);
+            player2.update(elapsed, platforms, pGrid, obstacles, oGrid, player1);
             // consistent map generation
             generateMap(background, left_panel_i, right_panel_i);
-            generateMap(platforms, left_platform_i, right_platform_i);
+            generateMap(platforms, left_platform_i, right_platform_i, &platformGrid);
             // obstacle generation
-            generateObstacles(obstacles);
+            generateObstacles();
+        } else {
+            // nothing is moving, so there is nothing to interpolate either
+            camera.previousPosition = camera.position;
+            player1.previousPosition = player1.position;
+            player2.previousPosition = player2.position;
         }
         if (player1.position.x + player1.size.x/2 < camera.position.x - camera.size.x/2) {
             gameOver = true;
@@ -378,6 +582,7 @@ public:
             gameOver = true;
         }
     }
+#ifndef HEADLESS
     void process(SDL_Event &event, const Uint8 *keys) {
         // pausing
         if (!gameOver) {
@@ -385,8 +590,15 @@ public:
             if (!keys[SDL_SCANCODE_ESCAPE]) { escPressed = false; }
         }
         if (!paused && !gameOver) {
-            player1.process(keys);
-            player2.process(keys);
+            PlayerInput input1;
+            input1.up = keys[SDL_SCANCODE_UP];
+            input1.right = keys[SDL_SCANCODE_RIGHT];
+            input1.left = keys[SDL_SCANCODE_LEFT];
+            PlayerInput input2;
+            input2.up = keys[SDL_SCANCODE_W];
+            input2.right = keys[SDL_SCANCODE_D];
+            input2.left = keys[SDL_SCANCODE_A];
+            processInput(input1, input2);
         } else if (paused) {
             if (keys[SDL_SCANCODE_SPACE]) {
                 paused = false;
@@ -403,29 +615,90 @@ public:
             }
         }
     }
-    void generateMap(std::vector<Entity> &vector, size_t &left_i, size_t &right_i) {
+    void playSounds() {
+        Player *players[] = {&player1, &player2};
+        for (Player *player : players) {
+            // posting a trigger never blocks the game thread
+            if (player->jumped) { mixer.Play(jump, SOUND_VOLUME); }
+            if (player->landed) { mixer.Play(landing, SOUND_VOLUME); }
+            player->jumped = false;
+            player->landed = false;
+        }
+    }
+#endif
+    void processInput(const PlayerInput &input1, const PlayerInput &input2) {
+        if (!paused && !gameOver) {
+            player1.process(input1);
+            player2.process(input2);
+        }
+    }
+    void generateMap(std::vector<Entity> &vector, size_t &left_i, size_t &right_i, CollisionGrid *grid = NULL) {
         if (vector[left_i].position.x + vector[right_i].size.x/2
             < camera.position.x - camera.size.x/2) {
             vector[left_i].position.x = vector[right_i].position.x + vector[left_i].size.x;
+            if (grid) { setGridBox(*grid, vector, (int)left_i); }
             left_i++;
             right_i++;
             if (left_i >= vector.size()) { left_i = 0; }
             if (right_i >= vector.size()) { right_i = 0; }
         }
     }
-    void generateObstacles(std::vector<Entity> &vector) {
-        for (int i=0; i < vector.size(); i++) {
-            if (vector[i].position.x + vector[i].size.x/2
-                < camera.position.x - camera.size.x/2) {
-                float x = camera.position.x + camera.size.x/2 + (rand() % 32) * 0.1;
-                x = floor(x * 10) / 10 + 0.15;
-                float y = -0.45 + (rand() % 12) * 0.101;
-                y = floor(y * 10) / 10 + 0.05;
-                vector[i].position.x = x;
-                vector[i].position.y = y;
+    void generateObstacles() {
+        // obstacles never move once placed, so they leave the screen in order of
+        // their right edge; only the ones that have are popped and respawned
+        float cameraLeft = camera.position.x - camera.size.x/2;
+        int spawnSlots = std::max(1, (int)(obstacleSpawnRange * 10));
+        while (!obstacleQueue.empty() && obstacleQueue.top().first < cameraLeft) {
+            int i = obstacleQueue.top().second;
+            obstacleQueue.pop();
+            float x = camera.position.x + camera.size.x/2 + obstacleRandom.NextInt(spawnSlots) * 0.1;
+            x = floor(x * 10) / 10 + 0.15;
+            float y = -0.45 + obstacleRandom.NextInt(12) * 0.101;
+            y = floor(y * 10) / 10 + 0.05;
+            obstacles[i].position.x = x;
+            obstacles[i].position.y = y;
+            setGridBox(obstacleGrid, obstacles, i);
+            obstacleQueue.push(std::make_pair(x + obstacles[i].size.x/2, i));
+            if (!obstacleRespawned[i]) {
+                obstacleRespawned[i] = true;
+                respawnedObstacles.push_back(i);
             }
         }
     }
+    // the same seed and inputs always give the same obstacles, on every
+    // restart as well as the first run
+    void seed(uint64_t seed) {
+        obstacleSeed = seed;
+        obstacleRandom.Seed(seed, OBSTACLE_STREAM);
+        buildObstacles((int)obstacles.size());
+    }
+    void buildPlatformGrid() {
+        platformGrid.Clear();
+        for (size_t i = 0; i < platforms.size(); i++) {
+            setGridBox(platformGrid, platforms, (int)i);
+        }
+    }
+    // parks count obstacles off screen and places them all ahead of the camera,
+    // drawing from a freshly seeded obstacleRandom
+    void buildObstacles(int count) {
+        obstacles.assign(count, Entity(-10, -0.45, 0.1, 0.1, 0.75, 0.75, 0.33, 1));
+        obstacleRespawned.assign(count, false);
+        obstacleGrid.Clear();
+        obstacleQueue = ObstacleQueue();
+        for (size_t i = 0; i < obstacles.size(); i++) {
+            obstacleQueue.push(std::make_pair(obstacles[i].position.x + obstacles[i].size.x/2, (int)i));
+        }
+        generateObstacles();
+        respawnedObstacles.clear();
+        obstacleRespawned.assign(count, false);
+        // with the restart count this is exactly the layout every restart replays
+        restartLayoutSaved = count == restartObstacleCount;
+        if (restartLayoutSaved) {
+            restartLayout = obstacles;
+            restartQueue = obstacleQueue;
+            restartRandom = obstacleRandom;
+        }
+    }
     void reset() {
         player1 = Player(0, 1.0, 0.099, 0.099, 0.75, 0.33, 0.33, 0.8, 0.3, 0);
         player2 = Player(0, 1.0, 0.099, 0.099, 0.33, 0.33, 0.75, 0.8, 0.3, 0);
@@ -434,13 +707,6 @@ public:
         escPressed = false;
         goToMenu = false;
         gameOver = false;
-        // player key bindings
-        player1.upKey = SDL_SCANCODE_UP;
-        player1.rightKey = SDL_SCANCODE_RIGHT;
-        player1.leftKey = SDL_SCANCODE_LEFT;
-        player2.upKey = SDL_SCANCODE_W;
-        player2.rightKey = SDL_SCANCODE_D;
-        player2.leftKey = SDL_SCANCODE_A;
         // background panels
         background.clear();
         background.push_back(Entity(-1.8, 0, 0.4, 2.0, 0.26, 0.26, 0.26, 1));
@@ -461,10 +727,22 @@ public:
         platforms.push_back(Entity(6.4, -10.5, 6.4, 20, 0.30, 0.45, 0.45, 1));
         left_platform_i = 0;
         right_platform_i = platforms.size() - 1;
-        // obstacles
-        obstacles.clear();
-        for (int i=0; i < 50; i++) {
-            obstacles.push_back(Entity(-10, -0.45, 0.1, 0.1, 0.75, 0.75, 0.33, 1));
+        buildPlatformGrid();
+        // every restart replays the same layout, so once it has been built only
+        // the obstacles that respawned since go back, and the grid moves just those
+        if (restartLayoutSaved) {
+            for (size_t j = 0; j < respawnedObstacles.size(); j++) {
+                int i = respawnedObstacles[j];
+                obstacles[i] = restartLayout[i];
+                setGridBox(obstacleGrid, obstacles, i);
+                obstacleRespawned[i] = false;
+            }
+            respawnedObstacles.clear();
+            obstacleQueue = restartQueue;
+            obstacleRandom = restartRandom;
+        } else {
+            obstacleRandom.Seed(obstacleSeed, OBSTACLE_STREAM);
+            buildObstacles(restartObstacleCount);
         }
     }
 
@@ -473,18 +751,51 @@ public:
     std::vector<Entity> background;
     std::vector<Entity> platforms;
     std::vector<Entity> obstacles;
+    // obstacles ordered by right edge, so the next one to scroll off is on top
+    typedef std::priority_queue<std::pair<float, int>, std::vector<std::pair<float, int> >,
+                                std::greater<std::pair<float, int> > > ObstacleQueue;
+    ObstacleQueue obstacleQueue;
+    // obstacles moved since the level was last laid out, each listed once
+    std::vector<int> respawnedObstacles;
+    std::vector<bool> obstacleRespawned;
+    // the layout every restart starts from, and the spawn state that goes with it
+    std::vector<Entity> restartLayout;
+    ObstacleQueue restartQueue;
+    Random restartRandom;
+    bool restartLayoutSaved;
+    CollisionGrid platformGrid;
+    CollisionGrid obstacleGrid;
     Camera camera;
     size_t left_panel_i;
     size_t right_panel_i;
     size_t left_platform_i;
     size_t right_platform_i;
+    uint64_t obstacleSeed;
+    Random obstacleRandom;
+    int obstacleCount;
+    int restartObstacleCount;
+    // width of the strip past the right edge of the screen that obstacles respawn in
+    float obstacleSpawnRange;
+    // off tests the players against every solid, for comparison
+    bool broadphase;
     bool paused;
     bool escPressed;
     bool gameOver;
     bool goToMenu;
     bool restart;
+#ifndef HEADLESS
+    // overlays
+    TextBox pausedTitle;
+    TextBox pausedResume;
+    TextBox pausedRestart;
+    TextBox pausedQuit;
+    TextBox gameOverTitle;
+    TextBox gameOverRestart;
+    TextBox gameOverQuit;
+#endif
 };
 
+#ifndef HEADLESS
 class Menu {
 public:
     Menu()
@@ -501,15 +812,25 @@ public:
         }
     }
     void update(float elapsed, GameMode &mode) {
-        if (goToGameLevel) {
+        // the level needs its sounds and the pause text its font
+        if (goToGameLevel && assets.Finished()) {
             mode = LEVEL;
             goToGameLevel = false;
         }
     }
-    void render(ShaderProgram &p, ShaderProgram &pTex) {
-        title.draw(pTex);
-        play.draw(pTex);
-        quit.draw(pTex);
+    void render(SpriteBatch &batch, ShaderProgram &pTex, float alpha) {
+        if (!assets.Finished()) {
+            // loading bar
+            batch.DrawQuad(glm::vec3(0, -0.6, 0), glm::vec3(1.6, 0.04, 1), 0, glm::vec4(0.2, 0.3, 0.3, 1));
+            float width = 1.6 * assets.Progress();
+            batch.DrawQuad(glm::vec3(-0.8 + width / 2, -0.6, 0), glm::vec3(width, 0.04, 1), 0, glm::vec4(0.9, 0.9, 0.9, 1));
+            batch.Flush();
+        }
+        if (font != 0) {
+            title.draw(pTex);
+            play.draw(pTex);
+            quit.draw(pTex);
+        }
     }
     
     TextBox title;
@@ -533,30 +854,84 @@ void setup() {
     SDL_GL_MakeCurrent(displayWindow, context);
     glViewport(0, 0, 1280, 800);
     projectionMatrix = glm::ortho(-1.6, 1.6, -1.0, 1.0, -1.0, 1.0);
-    // program
-    program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
-    programTex.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
-    glUseProgram(program.programID);
-    program.SetViewMatrix(viewMatrix);
-    program.SetProjectionMatrix(projectionMatrix);
+    // everything comes out of one mapped file when the pack has been built
+    // (see --pack), otherwise from the loose files
+    if (pack.Open(RESOURCE_FOLDER"assets.pack")) {
+        assets.pack = &pack;
+        assets.packFolder = RESOURCE_FOLDER;
+    }
+    {
+        PROFILE_SCOPE("Load shaders");
+        AssetView vertex, fragment;
+        if (pack.Find("vertex_batch.glsl", vertex) && pack.Find("fragment_batch.glsl", fragment)) {
+            batch.LoadFromSource(vertex.Chars(), vertex.size, fragment.Chars(), fragment.size);
+        } else {
+            batch.Load(RESOURCE_FOLDER"vertex_batch.glsl", RESOURCE_FOLDER"fragment_batch.glsl");
+        }
+        if (pack.Find("vertex_textured.glsl", vertex) && pack.Find("fragment_textured.glsl", fragment)) {
+            programTex.LoadFromSource(vertex.Chars(), vertex.size, fragment.Chars(), fragment.size);
+        } else {
+            programTex.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
+        }
+    }
+    // sprite batch
+    batch.program.SetViewMatrix(viewMatrix);
+    batch.program.SetProjectionMatrix(projectionMatrix);
+    batch.program.SetModelMatrix(modelMatrix);
     // texture program
-    programTex.Load(RESOURCE_FOLDER"vertex_textured.glsl", RESOURCE_FOLDER"fragment_textured.glsl");
-    glUseProgram(programTex.programID);
+    programTex.Use();
     programTex.SetProjectionMatrix(projectionMatrix);
     programTex.SetViewMatrix(viewMatrix);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    // Textures
-    font = LoadTexture(RESOURCE_FOLDER"font.png");
-    // Sounds
-    Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096);
-    music = Mix_LoadMUS(RESOURCE_FOLDER"Chiptronical.mp3");
-    jump = Mix_LoadWAV(RESOURCE_FOLDER"jump.wav");
-    landing = Mix_LoadWAV(RESOURCE_FOLDER"landing.wav");
-    Mix_VolumeMusic(60);
-    Mix_VolumeChunk(jump, 100);
-    Mix_VolumeChunk(landing, 100);
-    Mix_PlayMusic(music, -1);
+    // decoded images are kept under the per-user data folder between runs
+    char *cachePath = SDL_GetPrefPath("NYUCodebase", "project");
+    if (cachePath != NULL) {
+        textureCache.directory = cachePath;
+        assets.cache = &textureCache;
+        removeConvertedMusic(cachePath);
+        SDL_free(cachePath);
+    }
+    // Sound effects are converted to the effect mixer's rate, whatever its
+    // device ended up with
+    mixer.Open(44100, soundBufferFrames);
+    int frequency = mixer.frequency > 0 ? mixer.frequency : 44100;
+    // A WAV of the music shipped in the pack or the bundle (made offline with
+    // --convert-music) streams with a fixed amount resident. Without one the
+    // mp3 plays through SDL_mixer and its big buffer.
+    AssetView musicSource;
+    bool streaming = pack.Find("Chiptronical.wav", musicSource) ?
+        musicStream.Open(musicSource.data, musicSource.size, frequency, true) :
+        musicStream.Open(RESOURCE_FOLDER"Chiptronical.wav", frequency, true);
+    if (streaming) {
+        mixer.PlayMusic(&musicStream, MUSIC_VOLUME);
+    } else {
+        Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096);
+    }
+    // Assets finish loading in the background, handed over by render()
+    assets.QueueImage(RESOURCE_FOLDER"font.png", [](LoadedAsset &asset) {
+        if (asset.ok) {
+            font = UploadTexture(asset.pixels, asset.width, asset.height);
+        }
+    });
+    if (!streaming) {
+        assets.QueueFile(RESOURCE_FOLDER"Chiptronical.mp3", [](LoadedAsset &asset) {
+            if (!asset.ok) {
+                return;
+            }
+            // bytes stays valid whether it points into the pack or into musicData
+            musicData.swap(asset.data);
+            music = Mix_LoadMUS_RW(SDL_RWFromConstMem(asset.bytes, (int)asset.byteCount), 1);
+            Mix_VolumeMusic(60);
+            Mix_PlayMusic(music, -1);
+        });
+    }
+    assets.QueueSound(RESOURCE_FOLDER"jump.wav", frequency, AUDIO_S16SYS, 2, [](LoadedAsset &asset) {
+        jump = MakeSound(asset, jumpSamples);
+    });
+    assets.QueueSound(RESOURCE_FOLDER"landing.wav", frequency, AUDIO_S16SYS, 2, [](LoadedAsset &asset) {
+        landing = MakeSound(asset, landingSamples);
+    });
 }
 
 void process() {
@@ -564,6 +939,11 @@ void process() {
         if (event.type == SDL_QUIT || event.type == SDL_WINDOWEVENT_CLOSE) {
             gameDone = true;
         }
+        // F1 dumps the previous frame's batch stats
+        if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_F1) {
+            std::cout << "Draw calls: " << batch.drawCalls << ", quads: " << batch.quadCount << std::endl;
+            GLState::PrintStats();
+        }
     }
     switch (mode) {
         case MENU:
@@ -582,49 +962,383 @@ void update(float elapsed) {
             break;
         case LEVEL:
             level.update(elapsed, mode);
+            level.playSounds();
             break;
     }
 }
 
-void render() {
+void render(float alpha) {
+    if (!assets.Finished()) {
+        assets.Update(ASSET_UPLOAD_BUDGET);
+        if (assets.Finished() && !assetsReported) {
+            std::cout << "Assets loaded after " << millisecondsSinceStart() << " ms" << std::endl;
+            assetsReported = true;
+        }
+    }
     glClearColor(0.30, 0.45, 0.45, 1.0);
     glClear(GL_COLOR_BUFFER_BIT);
+    batch.BeginFrame();
     switch (mode) {
         case MENU:
-            menu.render(program, programTex);
+            menu.render(batch, programTex, alpha);
             break;
         case LEVEL:
-            level.render(program, programTex);
+            level.render(batch, programTex, alpha);
             break;
     }
     SDL_GL_SwapWindow(displayWindow);
     glFlush();
+    if (!firstFrameReported) {
+        std::cout << "First frame after " << millisecondsSinceStart() << " ms" << std::endl;
+        firstFrameReported = true;
+    }
+}
+
+// --convert-music <in> <out.wav> [frequency]: converts a compressed track to
+// the WAV the game streams, to ship as Chiptronical.wav in the bundle or the
+// pack so no run has to play the mp3 through SDL_mixer
+int convertMusicFile(const std::string &inFile, const std::string &outFile, int frequency) {
+    size_t size = 0;
+    void *data = MapFile(inFile, size);
+    if (data == NULL) {
+        std::cout << "Unable to read " << inFile << std::endl;
+        return 1;
+    }
+    // decoding doesn't need to hear anything
+    if (SDL_getenv("SDL_AUDIODRIVER") == NULL) {
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    }
+    SDL_Init(SDL_INIT_AUDIO);
+    bool ok = Mix_OpenAudio(frequency, MIX_DEFAULT_FORMAT, 2, 4096) == 0 &&
+              convertMusic((const unsigned char *)data, size, outFile, frequency);
+    Mix_CloseAudio();
+    SDL_Quit();
+    UnmapFile(data, size);
+    if (ok) {
+        std::cout << "Wrote " << outFile << std::endl;
+    }
+    return ok ? 0 : 1;
+}
+
+// --bench-audio [frames]: what mixing a full voice pool costs per buffer, then
+// how long triggers wait for the callback on a real device. Runs headless
+// under SDL's dummy driver by default; SDL_AUDIODRIVER=disk works too.
+int benchmarkAudio(int bufferFrames) {
+    // a ten second tone, long enough that no voice runs out during the test
+    int frequency = 44100;
+    std::vector<int16_t> tone((size_t)frequency * 10 * 2);
+    for (size_t frame = 0; frame < tone.size() / 2; frame++) {
+        int16_t sample = (int16_t)(8000.0 * sin(frame * 440.0 * 2.0 * 3.1415926 / frequency));
+        tone[frame * 2] = tone[frame * 2 + 1] = sample;
+    }
+    MixerSound sound;
+    sound.samples = tone.data();
+    sound.frames = (int)(tone.size() / 2);
+
+    std::vector<int16_t> out((size_t)bufferFrames * 2);
+    // every voice plays the whole tone
+    int buffers = sound.frames / bufferFrames - 1;
+    {
+        SoundMixer cost;
+        for (int i = 0; i < MIXER_MAX_VOICES; i++) {
+            cost.Play(sound, 0.1f);
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < buffers; i++) {
+            cost.Fill(out.data(), bufferFrames);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Mixing " << MIXER_MAX_VOICES << " voices: " << seconds * 1e6 / buffers << " us per "
+                  << bufferFrames << " frame buffer (" << bufferFrames * 1e6 / frequency << " us of audio)" << std::endl;
+    }
+
+    if (SDL_getenv("SDL_AUDIODRIVER") == NULL) {
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+    }
+    SoundMixer latency;
+    if (!latency.Open(frequency, bufferFrames)) {
+        return 1;
+    }
+    std::cout << "Audio driver: " << SDL_GetCurrentAudioDriver() << std::endl;
+    // short blips at uneven intervals, like jumps and landings
+    sound.frames = frequency / 20;
+    for (int i = 0; i < 300; i++) {
+        latency.Play(sound, 0.1f);
+        SDL_Delay(5 + i % 7);
+    }
+    latency.Close();
+    latency.PrintStats();
+    return 0;
+}
+
+// --bench-music [seconds]: loops a generated 1.3 second WAV through a
+// MusicStream and the mixer. Under SDL's disk driver (the default here) the
+// device output is read back and checked sample for sample against the track,
+// so a gap or glitch at a loop seam or an underrun shows up as a mismatch.
+int benchmarkMusic(int seconds) {
+    int frequency = 44100;
+    std::string trackFile = "bench_music.wav";
+    std::string outputFile = "bench_music.raw";
+    // a sawtooth that never crosses zero, so silence can't pass for music
+    std::vector<int16_t> track((size_t)(frequency * 1.3) * 2);
+    for (size_t frame = 0; frame < track.size() / 2; frame++) {
+        track[frame * 2] = (int16_t)(1000 + (frame * 37) % 20000);
+        track[frame * 2 + 1] = (int16_t)(-1000 - (frame * 53) % 20000);
+    }
+    if (!writeWAV(trackFile, track.data(), track.size() / 2, frequency)) {
+        return 1;
+    }
+
+    if (SDL_getenv("SDL_AUDIODRIVER") == NULL) {
+        SDL_setenv("SDL_AUDIODRIVER", "disk", 1);
+        SDL_setenv("SDL_DISKAUDIOFILE", outputFile.c_str(), 1);
+    }
+    SoundMixer benchMixer;
+    MusicStream stream;
+    if (!benchMixer.Open(frequency, SOUND_BUFFER_FRAMES) || !stream.Open(trackFile, benchMixer.frequency, true)) {
+        return 1;
+    }
+    std::string driver = SDL_GetCurrentAudioDriver();
+    benchMixer.PlayMusic(&stream, 1.0f);
+    SDL_Delay(seconds * 1000);
+    benchMixer.StopMusic();
+    benchMixer.Close();
+    std::cout << "Audio driver: " << driver << std::endl;
+    std::cout << "Track: " << track.size() * sizeof(int16_t) << " bytes, " << stream.loops << " loops" << std::endl;
+    std::cout << "Resident: " << MusicStream::MemoryUsed() << " bytes" << std::endl;
+    std::cout << "Underruns: " << stream.underrunFrames << " frames" << std::endl;
+    std::cout << "Longest callback: " << benchMixer.fillTimeMax / 1e3 << " us" << std::endl;
+    stream.Close();
+    remove(trackFile.c_str());
+
+    bool ok = stream.underrunFrames == 0;
+    if (driver == "disk") {
+        std::vector<int16_t> output;
+        FILE *in = fopen(outputFile.c_str(), "rb");
+        if (in != NULL) {
+            int16_t buffer[4096];
+            size_t count;
+            while ((count = fread(buffer, sizeof(int16_t), 4096, in)) > 0) {
+                output.insert(output.end(), buffer, buffer + count);
+            }
+            fclose(in);
+        }
+        remove(outputFile.c_str());
+        // silence before PlayMusic and after StopMusic is expected
+        size_t first = 0;
+        while (first < output.size() && output[first] == 0) {
+            first++;
+        }
+        size_t last = output.size();
+        while (last > first && output[last - 1] == 0) {
+            last--;
+        }
+        size_t mismatches = 0;
+        for (size_t i = first; i < last; i++) {
+            if (output[i] != track[(i - first) % track.size()]) {
+                mismatches++;
+            }
+        }
+        std::cout << "Played back: " << (last - first) / 2 << " frames, " << mismatches << " samples differ from the track" << std::endl;
+        ok = ok && last > first && mismatches == 0;
+    }
+    return ok ? 0 : 1;
 }
 
-int main() {
+static int printUsage(const char *program) {
+    std::cout << "usage: " << program << " [--seed S] [--audio-buffer 16-32768] [--profile prefix]\n"
+              << "       " << program << " --pack out.pack folder/ files...\n"
+              << "       " << program << " --convert-music in out.wav [8000-192000 Hz]\n"
+              << "       " << program << " --bench-audio [16-32768 frames]\n"
+              << "       " << program << " --bench-music [1-600 seconds]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    startTime = std::chrono::steady_clock::now();
+    long value;
+    // --pack <out.pack> <folder/> <files...> builds an asset pack instead of
+    // running the game
+    if (argc >= 4 && strcmp(argv[1], "--pack") == 0) {
+        return AssetPack::Write(argv[2], argv[3], std::vector<std::string>(argv + 4, argv + argc)) ? 0 : 1;
+    }
+    if (argc >= 4 && strcmp(argv[1], "--convert-music") == 0) {
+        value = 44100;
+        if (argc >= 5 && !parseArgument(argv[4], 8000, 192000, value)) {
+            return printUsage(argv[0]);
+        }
+        return convertMusicFile(argv[2], argv[3], (int)value);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench-audio") == 0) {
+        value = SOUND_BUFFER_FRAMES;
+        if (argc >= 3 && !parseArgument(argv[2], 16, 32768, value)) {
+            return printUsage(argv[0]);
+        }
+        return benchmarkAudio((int)value);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench-music") == 0) {
+        value = 5;
+        if (argc >= 3 && !parseArgument(argv[2], 1, 600, value)) {
+            return printUsage(argv[0]);
+        }
+        return benchmarkMusic((int)value);
+    }
+    // --seed S replays the same obstacles for the same inputs, --audio-buffer N
+    // sets the sound effect buffer in frames
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0) {
+            if (i + 1 >= argc || !parseArgument(argv[++i], 0, LONG_MAX, value)) {
+                return printUsage(argv[0]);
+            }
+            level.seed((uint64_t)value);
+        } else if (strcmp(argv[i], "--audio-buffer") == 0) {
+            if (i + 1 >= argc || !parseArgument(argv[++i], 16, 32768, value)) {
+                return printUsage(argv[0]);
+            }
+            soundBufferFrames = (int)value;
+        }
+    }
     setup();
 #ifdef _WINDOWS
     glewInit();
 #endif
-    while (!gameDone) {
-        float ticks = SDL_GetTicks()/1000.0;
-        float elapsed = ticks - lastFrameTicks;
-        lastFrameTicks = ticks;
-        elapsed += accumulator;
-        if (elapsed < FIXED_TIMESTEP) {
-            accumulator = elapsed;
-            continue;
-        }
-        process();
-        while (elapsed >= FIXED_TIMESTEP) {
-            update(elapsed);
-            elapsed -= FIXED_TIMESTEP;
-        }
-        render();
+    GameLoop loop(FIXED_TIMESTEP);
+    loop.Run(gameDone, process, update, render);
+    loop.PrintStats();
+    Profiler::PrintFrameStats();
+    std::string profilePrefix = Profiler::CapturePrefix(argc, argv);
+    if (!profilePrefix.empty()) {
+        Profiler::WriteCapture(profilePrefix);
+    }
+    mixer.Close();
+    mixer.PrintStats();
+    if (musicStream.IsOpen()) {
+        std::cout << "Music underruns: " << musicStream.underrunFrames << " frames" << std::endl;
+        musicStream.Close();
     }
+    textMeshes.Cleanup();
     Mix_FreeMusic(music);
-    Mix_FreeChunk(jump);
-    Mix_FreeChunk(landing);
     SDL_Quit();
     return 0;
 }
+#else
+/*
+ Headless runner: steps the level at the fixed timestep as fast as it can, with
+ scripted or random input, and reports the simulation rate.
+   --ticks N          number of fixed steps to run (default 100000)
+   --input MODE       "scripted" (default) or "random"
+   --input-seed S     seed for random input (default 1)
+   --obstacles N      obstacle count (default 45); the strip they respawn in
+                      widens with the count so their density stays the same
+   --no-broadphase    test players against every solid instead of the grid
+   --seed S           obstacle generation seed (default 1)
+*/
+static int printUsage(const char *program) {
+    std::cout << "usage: " << program << " [--ticks N] [--input scripted|random] [--input-seed S]"
+              << " [--obstacles N] [--no-broadphase] [--seed S]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    long ticks = 100000;
+    bool randomInput = false;
+    unsigned int inputSeed = 1;
+    int obstacleCount = 45;
+    bool broadphase = true;
+    uint64_t seed = DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        long value;
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            // the per-tick timings are kept, so this also bounds their memory
+            if (!parseArgument(argv[++i], 0, 100000000, value)) {
+                return printUsage(argv[0]);
+            }
+            ticks = value;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            randomInput = strcmp(argv[++i], "random") == 0;
+        } else if (strcmp(argv[i], "--input-seed") == 0 && i + 1 < argc) {
+            if (!parseArgument(argv[++i], 0, UINT_MAX, value)) {
+                return printUsage(argv[0]);
+            }
+            inputSeed = (unsigned int)value;
+        } else if (strcmp(argv[i], "--obstacles") == 0 && i + 1 < argc) {
+            if (!parseArgument(argv[++i], 1, 1000000, value)) {
+                return printUsage(argv[0]);
+            }
+            obstacleCount = (int)value;
+        } else if (strcmp(argv[i], "--no-broadphase") == 0) {
+            broadphase = false;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            if (!parseArgument(argv[++i], 0, LONG_MAX, value)) {
+                return printUsage(argv[0]);
+            }
+            seed = (uint64_t)value;
+        } else {
+            return printUsage(argv[0]);
+        }
+    }
+    
+    Level level(obstacleCount, obstacleCount, 3.2f * obstacleCount / 45, seed);
+    level.broadphase = broadphase;
+    GameMode mode = LEVEL;
+    std::mt19937 inputRandom(inputSeed);
+    long gameOvers = 0;
+    long jumps = 0;
+    
+    // per-tick cost, so the occasional restart doesn't hide the steady state
+    std::vector<float> tickTimes(ticks);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long tick = 0; tick < ticks; tick++) {
+        PlayerInput input1;
+        PlayerInput input2;
+        if (randomInput) {
+            unsigned int bits = inputRandom();
+            input1.up = (bits & 0x7) == 0;
+            input1.right = (bits & 0x18) != 0;
+            input1.left = (bits & 0x18) == 0;
+            input2.up = (bits & 0x700) == 0;
+            input2.right = (bits & 0x1800) != 0;
+            input2.left = (bits & 0x1800) == 0;
+        } else {
+            // both players run right, jumping at staggered intervals, but wait for
+            // the camera once past its centre so they never outrun the platforms
+            input1.right = level.player1.position.x < level.camera.position.x;
+            input2.right = level.player2.position.x < level.camera.position.x;
+            input1.up = tick % 45 == 0;
+            input2.up = tick % 60 == 30;
+        }
+        std::chrono::steady_clock::time_point tickStart = std::chrono::steady_clock::now();
+        level.processInput(input1, input2);
+        level.update(FIXED_TIMESTEP, mode);
+        tickTimes[tick] = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - tickStart).count();
+        if (level.player1.jumped) { jumps++; }
+        if (level.player2.jumped) { jumps++; }
+        level.player1.jumped = level.player1.landed = false;
+        level.player2.jumped = level.player2.landed = false;
+        // a player that drops below the screen can never get back up, so that
+        // ends the run as well
+        float floor = level.camera.position.y - level.camera.size.y/2;
+        if (level.player1.position.y < floor || level.player2.position.y < floor) {
+            level.gameOver = true;
+        }
+        if (level.gameOver) {
+            gameOvers++;
+            level.restart = true;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::cout << "Ticks: " << ticks << " (" << ticks * FIXED_TIMESTEP << "s simulated)" << std::endl;
+    std::cout << "Obstacles: " << obstacleCount << ", broadphase " << (broadphase ? "on" : "off")
+              << ", seed " << seed << std::endl;
+    std::cout << "Elapsed: " << seconds << "s, " << ticks / seconds << " ticks/s, "
+              << seconds / ticks * 1000000.0 << " us/tick" << std::endl;
+    if (ticks > 0) {
+        std::sort(tickTimes.begin(), tickTimes.end());
+        std::cout << "Tick cost: p50 " << tickTimes[ticks / 2] << " us, p99 " << tickTimes[ticks * 99 / 100]
+                  << " us, max " << tickTimes[ticks - 1] << " us" << std::endl;
+    }
+    std::cout << "Jumps: " << jumps << ", game overs: " << gameOvers << std::endl;
+    return 0;
+}
+#endif
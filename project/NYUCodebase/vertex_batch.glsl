@@ -0,0 +1,18 @@
+attribute vec4 position;
+attribute vec2 texCoord;
+attribute vec4 vertexColor;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+
+varying vec2 texCoordVar;
+varying vec4 colorVar;
+
+void main()
+{
+	vec4 p = viewMatrix * modelMatrix  * position;
+    texCoordVar = texCoord;
+    colorVar = vertexColor;
+	gl_Position = projectionMatrix * p;
+}
\ No newline at end of file
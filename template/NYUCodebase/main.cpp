@@ -36,7 +36,7 @@ void Setup() {
     glViewport(0, 0, 960, 720);
     projectionMatrix = glm::ortho(-1.333, 1.333, -1.0, 1.0, -1.0, 1.0);
     program.Load(RESOURCE_FOLDER"vertex.glsl", RESOURCE_FOLDER"fragment.glsl");
-    glUseProgram(program.programID);
+    program.Use();
     program.SetProjectionMatrix(projectionMatrix);
     program.SetViewMatrix(viewMatrix);
 }